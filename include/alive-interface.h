@@ -12,28 +12,52 @@
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/Argument.h"
 
-#include <iostream>
 #include <ostream>
+#include <streambuf>
 #include <unordered_map>
 
 namespace minotaur {
 
 static std::ostream NOP_OSTREAM(nullptr);
 
+// alive2 prints to a std::ostream, this one forwards to the debug stream of
+// a context
+class DebugStreamBuf final : public std::streambuf {
+  llvm::raw_ostream &os;
+protected:
+  int_type overflow(int_type c) override {
+    if (!traits_type::eq_int_type(c, traits_type::eof()))
+      os << traits_type::to_char_type(c);
+    return c;
+  }
+  std::streamsize xsputn(const char *s, std::streamsize n) override {
+    os.write(s, n);
+    return n;
+  }
+public:
+  explicit DebugStreamBuf(llvm::raw_ostream &os) : os(os) {}
+};
+
 class AliveEngine {
 private:
   llvm::TargetLibraryInfoWrapperPass &TLI;
+  const MinotaurContext &mctx;
+  DebugStreamBuf debug_buf;
+  std::ostream debug_os;
   std::ostream *debug;
+  bool dpi;
+
+  void setConfig() const;
 
   util::Errors find_model(tools::Transform &t,
     std::unordered_map<const IR::Value*, smt::expr>&);
 
 public:
-  AliveEngine(llvm::TargetLibraryInfoWrapperPass &TLI, bool dpi) : TLI(TLI) {
-    util::config::disable_undef_input = true;
-    util::config::disable_poison_input = dpi;
-    util::config::use_exact_fp = dpi;
-    debug = config::debug_tv ? &std::cerr : &NOP_OSTREAM;
+  AliveEngine(llvm::TargetLibraryInfoWrapperPass &TLI, bool dpi,
+              const MinotaurContext &mctx)
+    : TLI(TLI), mctx(mctx), debug_buf(mctx.dbg()), debug_os(&debug_buf),
+      dpi(dpi) {
+    debug = mctx.debug_tv ? &debug_os : &NOP_OSTREAM;
   }
 
   bool constantSynthesis(llvm::Function&, llvm::Function&,
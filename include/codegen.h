@@ -4,6 +4,7 @@
 #pragma once
 
 #include "alive-interface.h"
+#include "config.h"
 #include "expr.h"
 
 #include "llvm/IR/Function.h"
@@ -19,11 +20,17 @@ class LLVMGen {
   llvm::IRBuilder<> b;
   llvm::Module *M;
   llvm::LLVMContext &C;
+  const MinotaurContext &mctx;
 public:
+  // every floating point operation is emitted with the flags FMF
   LLVMGen(llvm::Instruction *I,
-          std::unordered_set<llvm::Function *> &IDs)
+          std::unordered_set<llvm::Function *> &IDs,
+          const MinotaurContext &mctx,
+          llvm::FastMathFlags FMF = llvm::FastMathFlags())
     : IntrinsicDecls(IDs), b(llvm::IRBuilder<>(I)),
-      M(I->getModule()), C(I->getContext()) {};
+      M(I->getModule()), C(I->getContext()), mctx(mctx) {
+    b.setFastMathFlags(FMF);
+  };
   llvm::Value *codeGen(Inst*, llvm::ValueToValueMapTy &VMap);
   llvm::Value *bitcastTo(llvm::Value*, llvm::Type*);
 
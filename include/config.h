@@ -7,26 +7,40 @@
 #include <ostream>
 
 namespace minotaur {
-namespace config {
 
-extern bool disable_poison_input;
-extern bool disable_undef_input;
-extern bool debug_slicer;
-extern bool debug_enumerator;
-extern bool debug_tv;
-extern bool debug_codegen;
-extern bool debug_parser;
-extern bool ignore_machine_cost;
-extern bool smt_verbose;
-extern bool disable_avx512;
-extern bool show_stats;
-extern bool return_first_solution;
-
-extern unsigned slice_to;
-extern unsigned slicer_max_depth;
-
-llvm::raw_ostream &dbg();
-void set_debug(llvm::raw_ostream &os);
+// settings of one minotaur invocation. the pass, the tools and every
+// synthesis worker own their context, and hand it down to the slicer, the
+// enumerator, the verifier, the code generator and the parser, so that
+// independent invocations can run concurrently in one process.
+struct MinotaurContext {
+  bool disable_undef_input = true;
+  bool debug_slicer = false;
+  bool debug_enumerator = false;
+  bool debug_tv = false;
+  bool debug_codegen = false;
+  bool debug_parser = false;
+  bool ignore_machine_cost = false;
+  // print the smt queries of the verifier
+  bool smt_verbose = false;
+  bool show_stats = false;
+  bool return_first_solution = false;
+
+  unsigned slice_to = 300;
+  unsigned slicer_max_depth = 5;
+  // inputs of the first round of enumeration, doubled while no solution is
+  // found within slice_to. 0 means all inputs at once.
+  unsigned max_inputs = 8;
+  // the costliest tier of sketches tried, see Tier. with fewer than all
+  // tiers, a slice without solution is left to the offline workers.
+  unsigned max_tier = 3;
+
+  llvm::raw_ostream *debug_os = &llvm::nulls();
+
+  llvm::raw_ostream &dbg() const { return *debug_os; }
+  void set_debug(llvm::raw_ostream &os) { debug_os = &os; }
+};
+
+namespace config {
 
 extern const char minotaur_version[];
 
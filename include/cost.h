@@ -10,4 +10,6 @@
 namespace minotaur {
 unsigned get_machine_cost(llvm::Function *F);
 unsigned get_approx_cost (llvm::Function *F);
+// the share of a single instruction in get_approx_cost
+unsigned get_approx_cost(llvm::Instruction *I);
 }
\ No newline at end of file
@@ -3,12 +3,16 @@
 #pragma once
 
 #include "alive-interface.h"
+#include "config.h"
 #include "ir/function.h"
 
 #include "expr.h"
+#include "sketch.h"
+#include "target.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
 #include "llvm/IR/Dominators.h"
 
+#include <atomic>
 #include <functional>
 #include <memory>
 #include <unordered_map>
@@ -20,20 +24,60 @@ class TargetLibraryInfo;
 
 namespace minotaur {
 
-using Sketch = std::pair<Inst*, std::set<ReservedConst*>>;
+// progress of one search
+struct SolveStats {
+  // candidates built from sketches
+  unsigned generated = 0;
+  // candidates dropped before verification
+  unsigned pruned = 0;
+  // candidates sent to the verifier
+  unsigned queried = 0;
+  // candidates proven to refine the slice
+  unsigned proven = 0;
+};
+
+// called on every rewrite that is proven and cheaper than the slice, as it
+// is found. returning false stops the search.
+using RewriteCallback =
+  std::function<bool(const Rewrite&, const SolveStats&)>;
+
+// stops a search from another thread. the search checks it before every
+// query, a query in flight is not interrupted.
+class CancelToken {
+  std::atomic<bool> cancelled = false;
+public:
+  void cancel() { cancelled = true; }
+  bool isCancelled() const { return cancelled; }
+};
 
 class Enumerator {
+  const MinotaurContext &mctx;
   std::vector<std::unique_ptr<Inst>> exprs;
 
+  // every candidate input, most relevant first
+  std::vector<Var*> inputs;
+  // the inputs sketches are built from in the current round
   std::vector<Var*> values;
+  // the features of the slice being solved
+  TargetFeatures features;
+  // the fast-math flags shared by the floating point operations of the slice,
+  // candidates are emitted and verified with them
+  llvm::FastMathFlags fmf;
 
   void findInputs(llvm::Function&,
                   llvm::Instruction*,
                   llvm::DominatorTree&);
+  void rankInputs(llvm::Instruction*, llvm::DominatorTree&);
+  // the sketches of one tier over the current values
   bool getSketches(llvm::Value *V,
-                   std::vector<Sketch>&);
+                   std::vector<Sketch>&, Tier);
 public:
+  Enumerator(const MinotaurContext &mctx) : mctx(mctx) {}
+  // every rewrite found, cheapest first
   std::vector<Rewrite> solve(llvm::Function&, llvm::Instruction*);
+  SolveStats solve(llvm::Function&, llvm::Instruction*,
+                   const RewriteCallback&,
+                   const CancelToken *Cancel = nullptr);
 };
 
 }
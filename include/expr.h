@@ -84,7 +84,7 @@ class UnaryOp final : public Value {
 public:
   enum Op { bitreverse, bswap, ctpop, ctlz, cttz,
             fneg, fabs , fceil, ffloor, frint, fnearbyint, fround,
-            froundeven, ftrunc };
+            froundeven, ftrunc, abs };
 private:
   Op op;
   Value *v;
@@ -105,6 +105,30 @@ public:
   }
 };
 
+// horizontal reduction of the lanes of workty, the value is one element
+class Reduction final : public Value {
+public:
+  enum Op { add, mul, band, bor, bxor, smax, smin, umax, umin,
+            fadd, fmul, fmax, fmin };
+private:
+  Op op;
+  Value *v;
+  type workty;
+public:
+  Reduction(Op op, Value &V, type &workty)
+  : Value(workty.getAsScalar()), op(op), v(&V), workty(workty) {}
+  void print(llvm::raw_ostream &os) const override;
+  Op K() { return op; }
+  Value *V() { return v; }
+  type getWorkTy() { return workty; }
+
+  static bool isFloatingPoint(Op op) {
+    return op == fadd || op == fmul || op == fmax || op == fmin;
+  }
+  static bool isLogical(Op op) {
+    return op == band || op == bor || op == bxor;
+  }
+};
 
 class BinaryOp final : public Value {
 public:
@@ -112,12 +136,16 @@ public:
             add, sub, mul, sdiv, udiv,
             umax, umin, smax, smin,
             fadd, fsub, fmul, fdiv, /*frem*/
-            fmaxnum, fminnum, fmaximum, fminimum, copysign };
+            fmaxnum, fminnum, fmaximum, fminimum, copysign,
+            uadd_sat, sadd_sat, usub_sat, ssub_sat, rotl, rotr };
+  // poison-generating flags
+  enum Flag : unsigned { nuw = 1, nsw = 2, exact = 4, disjoint = 8 };
 private:
   Op op;
   Value *lhs;
   Value *rhs;
   type workty;
+  unsigned flags = 0;
 public:
   BinaryOp(Op op, Value &lhs, Value &rhs, type &workty)
   : Value(lhs.getType()), op(op), lhs(&lhs), rhs(&rhs), workty(workty) {}
@@ -126,6 +154,22 @@ public:
   Value *R() { return rhs; }
   Op K() { return op; }
   type getWorkTy() { return workty; }
+  unsigned getFlags() { return flags; }
+  void setFlags(unsigned f) { flags = f; }
+
+  // the flags LLVM accepts on the instruction op is emitted as
+  static unsigned allowedFlags(Op op) {
+    switch (op) {
+    case add: case sub: case mul: case shl:
+      return nuw | nsw;
+    case sdiv: case udiv: case lshr: case ashr:
+      return exact;
+    case bor:
+      return disjoint;
+    default:
+      return 0;
+    }
+  }
 
   static bool isFloatingPoint(Op op) {
     return op == fadd || op == fsub || op == fmul || op == fdiv ||
@@ -141,12 +185,42 @@ public:
            op == fadd || op == fmul ||
            op == umax || op == umin || op == smax || op == smin ||
            op == fmaxnum || op == fminnum ||
-           op == fmaximum || op == fminimum;
+           op == fmaximum || op == fminimum ||
+           op == uadd_sat || op == sadd_sat;
   }
 
   static bool isLogical(Op op) {
     return op == band || op == bor || op == bxor;
   }
+
+  static bool isSaturating(Op op) {
+    return op == uadd_sat || op == sadd_sat ||
+           op == usub_sat || op == ssub_sat;
+  }
+};
+
+class TernaryOp final : public Value {
+public:
+  enum Op { fshl, fshr, fma, fmuladd };
+private:
+  Op op;
+  Value *a;
+  Value *b;
+  Value *c;
+  type workty;
+public:
+  TernaryOp(Op op, Value &a, Value &b, Value &c, type &workty)
+  : Value(a.getType()), op(op), a(&a), b(&b), c(&c), workty(workty) {}
+  void print(llvm::raw_ostream &os) const override;
+  Value *A() { return a; }
+  Value *B() { return b; }
+  Value *C() { return c; }
+  Op K() { return op; }
+  type getWorkTy() { return workty; }
+
+  static bool isFloatingPoint(Op op) {
+    return op == fma || op == fmuladd;
+  }
 };
 
 
@@ -200,59 +274,21 @@ public:
   Value *L() { return lhs; }
   Value *R() { return rhs; }
   IR::X86IntrinBinOp::Op K() { return op; }
-  static bool is512 (IR::X86IntrinBinOp::Op K) {
-    return K == IR::X86IntrinBinOp::x86_avx512_pavg_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pavg_b_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pshuf_b_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrl_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrl_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrl_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrli_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrli_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrli_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrlv_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrlv_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrlv_w_128 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrlv_w_256 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrlv_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psra_q_128 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psra_q_256 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psra_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psra_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psra_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrai_q_128 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrai_q_256 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrai_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrai_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrai_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrav_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrav_q_128 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrav_q_256 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrav_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrav_w_128 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrav_w_256 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psrav_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psll_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psll_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psll_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pslli_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pslli_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pslli_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psllv_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psllv_q_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psllv_w_128 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psllv_w_256 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psllv_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pmulh_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pmulhu_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pmaddw_d_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_pmaddubs_w_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_packsswb_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_packuswb_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_packssdw_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_packusdw_512 ||
-           K == IR::X86IntrinBinOp::x86_avx512_psad_bw_512;
-  }
+};
+
+class SIMDTerOpInst final : public Value {
+  IR::X86IntrinTerOp::Op op;
+  Value *a;
+  Value *b;
+  Value *c;
+public:
+  SIMDTerOpInst(IR::X86IntrinTerOp::Op op, Value &a, Value &b, Value &c)
+  : Value(type(getIntrinsicRetTy(op))), op(op), a(&a), b(&b), c(&c) {}
+  void print(llvm::raw_ostream &os) const override;
+  Value *A() { return a; }
+  Value *B() { return b; }
+  Value *C() { return c; }
+  IR::X86IntrinTerOp::Op K() { return op; }
 };
 
 
@@ -358,10 +394,11 @@ struct Rewrite {
   unsigned CostBefore;
 };
 
-std::vector<type> getBinaryOpWorkTypes(type expected, BinaryOp::Op op);
-std::vector<type> getUnaryOpWorkTypes(type expected, UnaryOp::Op op);
-std::vector<type> getShuffleWorkTypes(type expected);
-std::vector<type> getConversionOpWorkTypes(type to, type from);
-std::vector<type> getInsertElementWorkTypes(type expected);
+WorkTypes getBinaryOpWorkTypes(type expected, BinaryOp::Op op);
+WorkTypes getUnaryOpWorkTypes(type expected, UnaryOp::Op op);
+WorkTypes getTernaryOpWorkTypes(type expected, TernaryOp::Op op);
+WorkTypes getShuffleWorkTypes(type expected);
+WorkTypes getConversionOpWorkTypes(type to, type from);
+WorkTypes getInsertElementWorkTypes(type expected);
 
 }
@@ -0,0 +1,24 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "expr.h"
+
+#include "llvm/IR/Constant.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+
+#include <unordered_map>
+
+namespace minotaur {
+
+// solves the constants of a data movement sketch, a shuffle, extractelement
+// or insertelement over inputs, without a quantified query. every lane of the
+// arguments of F gets a distinct tag, F is evaluated on them, and the mask or
+// index is read off from where the lanes of Root take their tags. the result
+// still has to be verified. returns false when the sketch is not a data
+// movement or the tags of Root do not come from its operands.
+bool solveLaneHoles(llvm::Function &F, llvm::Instruction *Root, Inst *Sketch,
+                    std::unordered_map<ReservedConst*, llvm::Constant*> &Holes);
+
+} // namespace minotaur
@@ -21,11 +21,25 @@ struct yylval_t {
   yylval_t() {}
 };
 
-void yylex_init(std::string_view str);
-token yylex();
+// lexer state for one rewrite string. every parser owns its lexer, so
+// rewrites can be lexed on several threads at once.
+class lexer_t {
+  const unsigned char *cursor = nullptr;
+  const unsigned char *limit = nullptr;
+  const unsigned char *text = nullptr;
+  const unsigned char *marker = nullptr;
+
+  [[noreturn]] void error(std::string &&str) const;
+  void copy_str(unsigned off = 0);
+
+public:
+  yylval_t yylval;
+  unsigned yylineno = 0;
+
+  void yylex_init(std::string_view str);
+  token yylex();
+};
 
-extern yylval_t yylval;
-extern unsigned yylineno;
 extern const char *const token_name[];
 
 struct LexException {
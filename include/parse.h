@@ -1,6 +1,7 @@
 // Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
 // Distributed under the MIT license that can be found in the LICENSE file.
 #pragma once
+#include "config.h"
 #include "expr.h"
 #include "lexer.h"
 #include "llvm/IR/Function.h"
@@ -15,28 +16,61 @@ struct ParseException {
     : str(std::move(str)), lineno(lineno) {}
 };
 
+struct tokenizer_t {
+  lexer_t lexer;
+  token last;
+  // true if token last was 'unget' and should be returned next
+  bool returned = false;
+
+  void init(std::string_view buf);
+  token operator*();
+  token peek();
+  bool consumeIf(token expected);
+  void ensure(token expected);
+  void unget(token t);
+  bool empty();
+  bool isType();
+  bool isScalarType();
+  bool isVectorType();
+  [[noreturn]] void error(std::string &&s) const;
+
+private:
+  token get_new_token();
+};
+
 class Parser {
   std::vector<std::unique_ptr<minotaur::Inst>> exprs;
   llvm::Function &F;
+  const minotaur::MinotaurContext &mctx;
+  tokenizer_t tokenizer;
+
+  minotaur::type parse_scalar_type();
+  minotaur::type parse_vector_type();
+  minotaur::type parse_type();
+  unsigned parse_number();
 
   minotaur::Var             *parse_var();
   minotaur::ReservedConst   *parse_const();
   minotaur::Copy            *parse_copy();
   minotaur::UnaryOp         *parse_unary(token);
+  minotaur::Reduction       *parse_reduction(token);
   minotaur::BinaryOp        *parse_binary(token);
+  minotaur::TernaryOp       *parse_ternary(token);
   minotaur::ICmp            *parse_icmp(token);
   minotaur::FCmp            *parse_fcmp(token);
   minotaur::FakeShuffleInst *parse_shuffle(token);
   minotaur::IntConversion   *parse_intconv(token);
   minotaur::FPConversion    *parse_fpconv(token);
   minotaur::SIMDBinOpInst   *parse_x86(std::string_view ops);
+  minotaur::SIMDTerOpInst   *parse_x86_ter(std::string_view ops);
   minotaur::Select          *parse_select();
   minotaur::InsertElement   *parse_insertelement();
   minotaur::ExtractElement  *parse_extractelement();
   minotaur::Value* parse_expr();
 
 public:
-  Parser(llvm::Function &F) : F(F) {}
+  Parser(llvm::Function &F, const minotaur::MinotaurContext &mctx)
+    : F(F), mctx(mctx) {}
   std::vector<minotaur::Rewrite> parse(const llvm::Function&, std::string_view);
 };
 
@@ -1,5 +1,10 @@
 // Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
 // Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "config.h"
+#include "slice.h"
+
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 #include "llvm/Analysis/PostDominators.h"
@@ -16,20 +21,26 @@
 
 namespace minotaur {
 
-class RemovalSlice {
+// collects the instructions the root depends on within its loop, up to
+// slicer_max_depth, and copies every block on the paths from their nearest
+// common dominator down to the root into the cut, see SliceCache::getPath.
+// then removes the instructions the root does not depend on. the control flow
+// of the region is kept as it is, branches leaving the region or going back
+// are sent to a sink block.
+class RemovalSlice : public Slicer {
+  std::unique_ptr<SliceCache> ownCache;
+  SliceCache &cache;
   llvm::Function &VF;
   llvm::LLVMContext &Ctx;
   llvm::LoopInfo &LI;
   llvm::DominatorTree &DT;
+  const MinotaurContext &mctx;
 
   std::unique_ptr<llvm::Module> M;
   llvm::ValueToValueMapTy mapping;
   bool discarded_at_precheck = false;
 
-public:
-  RemovalSlice(llvm::Function &VF, llvm::LoopInfo &LI, llvm::DominatorTree &DT)
-    : VF(VF), Ctx(VF.getContext()), LI(LI), DT(DT) {
-
+  void precheck() {
     for (auto &arg : VF.args()) {
       auto argTy = arg.getType();
       if (argTy->isPPC_FP128Ty() || argTy->isX86_FP80Ty())
@@ -39,10 +50,27 @@ public:
     M = std::make_unique<llvm::Module>("", Ctx);
     M->setDataLayout(VF.getParent()->getDataLayout());
   }
-  std::unique_ptr<llvm::Module> getNewModule() {return std::move(M); }
-  llvm::ValueToValueMapTy& getValueMap() { return mapping; }
-  std::optional<std::reference_wrapper<llvm::Function>>
-    extractExpr(llvm::Value &V);
+
+public:
+  RemovalSlice(llvm::Function &VF, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
+               const MinotaurContext &mctx)
+    : ownCache(std::make_unique<SliceCache>(VF, LI, DT, mctx)),
+      cache(*ownCache), VF(VF), Ctx(VF.getContext()), LI(LI), DT(DT),
+      mctx(mctx) {
+    precheck();
+  }
+  RemovalSlice(SliceCache &cache)
+    : cache(cache), VF(cache.getFunction()), Ctx(VF.getContext()),
+      LI(cache.getLoopInfo()), DT(cache.getDomTree()),
+      mctx(cache.getContext()) {
+    precheck();
+  }
+  std::unique_ptr<llvm::Module> getNewModule() override {
+    return std::move(M);
+  }
+  llvm::ValueToValueMapTy& getValueMap() override { return mapping; }
+  std::optional<std::pair<std::reference_wrapper<llvm::Function>,
+    llvm::Instruction*>> extractExpr(llvm::Value &V) override;
 };
 
-} // namespace minotaur
\ No newline at end of file
+} // namespace minotaur
@@ -0,0 +1,31 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "expr.h"
+
+#include "llvm/IR/Function.h"
+
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace minotaur {
+
+// compact binary encoding of a synthesized rewrite, stored in the cache in
+// place of the s-expression printed by Inst::print. the layout is described
+// in lib/serialize.cpp.
+constexpr unsigned SERIALIZE_VERSION = 2;
+
+bool isSerialized(std::string_view buf);
+
+std::string serialize(Inst *I);
+
+// decodes a rewrite against the cut it was synthesized for, variables are
+// resolved by name in F. the decoded nodes are owned by exprs. returns
+// nullptr if buf is malformed or refers to an unknown variable.
+Inst *deserialize(std::string_view buf, llvm::Function &F,
+                  std::vector<std::unique_ptr<Inst>> &exprs);
+
+} // namespace minotaur
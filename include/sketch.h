@@ -0,0 +1,87 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "expr.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/IR/FMF.h"
+
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace minotaur {
+
+using Sketch = std::pair<Inst*, std::set<ReservedConst*>>;
+
+// sketches are verified in tiers, the cheapest to verify first. a tier only
+// runs when the tiers before it found no profitable rewrite.
+enum class Tier : unsigned {
+  // the inputs themselves
+  Trivial,
+  // one operation over inputs
+  SingleOp,
+  // constants to synthesize, alone or under one operation
+  Holes,
+  // nested operations and target intrinsics
+  Complex,
+};
+constexpr unsigned NumTiers = 4;
+
+Tier tierOf(const Sketch &S);
+
+// the operands of an instruction, reserved constants included
+llvm::SmallVector<Value*, 3> operands(Inst *I);
+
+// the sketches of a slice only depend on the types of its inputs, the type
+// of the root, the target features and the fast-math flags. a template
+// holds the sketches built once over placeholder inputs, the slots, and is
+// never modified after it is built, so that enumerators on different
+// threads can share it.
+struct SketchTemplate {
+  std::vector<std::unique_ptr<Inst>> exprs;
+  std::vector<Var*> slots;
+  std::vector<Sketch> sketches;
+  // the tier of each sketch
+  std::vector<Tier> tiers;
+};
+
+// copies the sketches of T, or only those of one tier, into exprs. slot i is
+// bound to inputs[i] and every reserved constant is replaced by a fresh one.
+void instantiate(const SketchTemplate &T, const std::vector<Var*> &inputs,
+                 std::vector<Sketch> &sketches,
+                 std::vector<std::unique_ptr<Inst>> &exprs,
+                 std::optional<Tier> Only = std::nullopt);
+
+// process wide cache of sketch templates
+class SketchCache {
+  std::mutex lock;
+  std::unordered_map<std::string,
+                     std::shared_ptr<const SketchTemplate>> templates;
+  unsigned hits = 0, misses = 0;
+
+public:
+  // the cache is dropped as a whole when it grows past this
+  static constexpr size_t MaxTemplates = 4096;
+
+  static SketchCache &get();
+
+  // inputs must be in the order they are bound to the slots, features is
+  // the key of the target features
+  static std::string key(const std::vector<Var*> &inputs, type expected,
+                         const std::string &features,
+                         llvm::FastMathFlags FMF);
+
+  std::shared_ptr<const SketchTemplate> lookup(const std::string &key);
+  void insert(const std::string &key,
+              std::shared_ptr<const SketchTemplate> T);
+  std::pair<unsigned, unsigned> stats();
+};
+
+} // namespace minotaur
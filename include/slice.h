@@ -1,5 +1,12 @@
 // Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
 // Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "config.h"
+
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/Analysis/AssumptionCache.h"
+#include "llvm/Analysis/DemandedBits.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 #include "llvm/Analysis/PostDominators.h"
@@ -11,28 +18,148 @@
 #include "llvm/Transforms/Utils/ValueMapper.h"
 
 #include <functional>
+#include <map>
 #include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace minotaur {
 
-class Slice {
+// the slicer does not harvest values of these types
+bool isUnsupportedTy(llvm::Type *ty);
+
+// pairs of instructions of bb worth cutting together, see
+// -minotaur-multi-root: values of one type that read a common value, so that
+// a rewrite may compute what they share once
+std::vector<std::vector<llvm::Instruction*>>
+relatedRoots(llvm::BasicBlock &bb);
+
+// per-function state shared by the slices of all the instructions of a
+// function: whether an instruction may be harvested at all, whether a loop
+// is in simplified form, the blocks on the paths between two blocks and the
+// demanded bits of the instructions. none of these depend on the root being
+// sliced, so they are computed once.
+class SliceCache {
+public:
+  struct Node {
+    // passes the callee and operand filters of the slicer
+    bool harvestable;
+    // why the instruction is not harvestable, for debug output
+    std::string reason;
+  };
+
+private:
   llvm::Function &f;
   llvm::LoopInfo &LI;
   llvm::DominatorTree &DT;
+  const MinotaurContext &mctx;
+
+  std::unordered_map<llvm::Instruction*, Node> nodes;
+  // reachable blocks in reverse post-order, and their position in it
+  std::vector<llvm::BasicBlock*> rpo;
+  std::unordered_map<llvm::BasicBlock*, unsigned> number;
+  std::map<llvm::Loop*, bool> simplified;
+  std::map<std::pair<llvm::BasicBlock*, llvm::BasicBlock*>,
+           std::optional<std::set<llvm::BasicBlock*>>> paths;
+  std::unique_ptr<llvm::AssumptionCache> AC;
+  std::unique_ptr<llvm::DemandedBits> DB;
+
+  void numberBlocks();
+
+public:
+  SliceCache(llvm::Function &f, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
+             const MinotaurContext &mctx)
+    : f(f), LI(LI), DT(DT), mctx(mctx) {}
+
+  llvm::Function &getFunction() { return f; }
+  llvm::LoopInfo &getLoopInfo() { return LI; }
+  llvm::DominatorTree &getDomTree() { return DT; }
+  const MinotaurContext &getContext() const { return mctx; }
+
+  const Node &getNode(llvm::Instruction *i);
+  bool isSimplified(llvm::Loop *L);
+  // blocks on the paths from `from` back to its dominator `to`, computed in
+  // linear time from reachability sets. nullopt if they are too far apart
+  const std::optional<std::set<llvm::BasicBlock*>> &
+  getPath(llvm::BasicBlock *from, llvm::BasicBlock *to);
+  // the edge does not go forward in reverse post-order
+  bool isBackEdge(llvm::BasicBlock *from, llvm::BasicBlock *to);
+
+  // the value a cut returns for root, whose copy in the cut is clone. when
+  // the users of root in the function only depend on some of its bits, the
+  // copy is masked to them at the end of bb, so that a rewrite only has to
+  // preserve those bits and cuts differing in the mask are cached apart.
+  llvm::Value *demandedRoot(llvm::Instruction *root, llvm::Value *clone,
+                            llvm::BasicBlock *bb);
+
+  // drops the per-instruction results after the function has been rewritten,
+  // the CFG is not touched by a rewrite so the loop and path results stay
+  void invalidate() {
+    nodes.clear();
+    DB.reset();
+  }
+};
+
+// a slicer cuts the expression tree of a root instruction out of its
+// function into a new module, see -minotaur-slicer
+class Slicer {
+public:
+  virtual ~Slicer() = default;
+  virtual std::unique_ptr<llvm::Module> getNewModule() = 0;
+  // maps the values of the cut back to the values of the original function
+  virtual llvm::ValueToValueMapTy& getValueMap() = 0;
+  virtual std::optional<std::pair<std::reference_wrapper<llvm::Function>,
+    llvm::Instruction*>> extractExpr(llvm::Value&) = 0;
+  // cuts roots of one block and one type together, the cut returns them
+  // concatenated, see concat_roots, and the concatenation is the root of the
+  // cut. slicers that cannot cut several roots at once only take one
+  virtual std::optional<std::pair<std::reference_wrapper<llvm::Function>,
+    llvm::Instruction*>>
+  extractExprs(llvm::ArrayRef<llvm::Instruction*> roots) {
+    if (roots.size() != 1)
+      return std::nullopt;
+    return extractExpr(*roots[0]);
+  }
+};
+
+// grows the cut from the root, cloning the operands up to slicer_max_depth
+// and the blocks between them
+class Slice : public Slicer {
+  std::unique_ptr<SliceCache> ownCache;
+  SliceCache &cache;
+  llvm::Function &f;
+  llvm::LoopInfo &LI;
+  llvm::DominatorTree &DT;
+  const MinotaurContext &mctx;
 
   std::unique_ptr<llvm::Module> m;
   llvm::ValueToValueMapTy mapping;
 
 public:
-  Slice(llvm::Function &f, llvm::LoopInfo &LI, llvm::DominatorTree &DT)
-    : f(f), LI(LI), DT(DT) {
+  Slice(llvm::Function &f, llvm::LoopInfo &LI, llvm::DominatorTree &DT,
+        const MinotaurContext &mctx)
+    : ownCache(std::make_unique<SliceCache>(f, LI, DT, mctx)),
+      cache(*ownCache), f(f), LI(LI), DT(DT), mctx(mctx) {
     m = std::make_unique<llvm::Module>("", f.getContext());
     m->setDataLayout(f.getParent()->getDataLayout());
   }
-  std::unique_ptr<llvm::Module> getNewModule() {return std::move(m); }
-  llvm::ValueToValueMapTy& getValueMap() { return mapping; }
+  Slice(SliceCache &cache)
+    : cache(cache), f(cache.getFunction()), LI(cache.getLoopInfo()),
+      DT(cache.getDomTree()), mctx(cache.getContext()) {
+    m = std::make_unique<llvm::Module>("", f.getContext());
+    m->setDataLayout(f.getParent()->getDataLayout());
+  }
+  std::unique_ptr<llvm::Module> getNewModule() override {
+    return std::move(m);
+  }
+  llvm::ValueToValueMapTy& getValueMap() override { return mapping; }
+  std::optional<std::pair<std::reference_wrapper<llvm::Function>,
+    llvm::Instruction*>> extractExpr(llvm::Value&) override;
   std::optional<std::pair<std::reference_wrapper<llvm::Function>,
-    llvm::Instruction*>> extractExpr(llvm::Value&);
+    llvm::Instruction*>> extractExprs(llvm::ArrayRef<llvm::Instruction*>)
+    override;
 };
 
 } // namespace minotaur
\ No newline at end of file
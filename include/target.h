@@ -0,0 +1,34 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#pragma once
+
+#include "ir/instr.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/Function.h"
+
+#include <set>
+#include <string>
+
+namespace minotaur {
+
+// the x86 features a function is compiled for, read from its target-cpu and
+// target-features attributes. the enumerator only emits the intrinsics they
+// support.
+class TargetFeatures {
+  std::set<std::string> enabled;
+
+public:
+  // a function without target attributes is assumed to target avx2
+  static TargetFeatures get(const llvm::Function &F);
+  static TargetFeatures get(llvm::StringRef CPU, llvm::StringRef Features);
+
+  bool has(llvm::StringRef Feature) const;
+  bool supports(IR::X86IntrinBinOp::Op) const;
+  bool supports(IR::X86IntrinTerOp::Op) const;
+
+  // the enabled features some intrinsic depends on, comma separated. two
+  // functions with the same key get the same intrinsics.
+  std::string key() const;
+};
+
+} // namespace minotaur
@@ -25,6 +25,21 @@ TOKEN(FNEARBYINT)
 TOKEN(FROUND)
 TOKEN(FROUNDEVEN)
 TOKEN(FTRUNC)
+TOKEN(ABS)
+
+TOKEN(REDUCE_ADD)
+TOKEN(REDUCE_MUL)
+TOKEN(REDUCE_AND)
+TOKEN(REDUCE_OR)
+TOKEN(REDUCE_XOR)
+TOKEN(REDUCE_SMAX)
+TOKEN(REDUCE_SMIN)
+TOKEN(REDUCE_UMAX)
+TOKEN(REDUCE_UMIN)
+TOKEN(REDUCE_FADD)
+TOKEN(REDUCE_FMUL)
+TOKEN(REDUCE_FMAX)
+TOKEN(REDUCE_FMIN)
 
 TOKEN(BAND)
 TOKEN(BOR)
@@ -50,6 +65,22 @@ TOKEN(FMINNUM)
 TOKEN(FMAXIMUM)
 TOKEN(FMINIMUM)
 TOKEN(COPYSIGN)
+TOKEN(UADD_SAT)
+TOKEN(SADD_SAT)
+TOKEN(USUB_SAT)
+TOKEN(SSUB_SAT)
+TOKEN(ROTL)
+TOKEN(ROTR)
+
+TOKEN(NUW)
+TOKEN(NSW)
+TOKEN(EXACT)
+TOKEN(DISJOINT)
+
+TOKEN(FSHL)
+TOKEN(FSHR)
+TOKEN(FMA)
+TOKEN(FMULADD)
 
 TOKEN(EQ)
 TOKEN(NE)
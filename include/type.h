@@ -3,6 +3,8 @@
 #pragma once
 
 #include "ir/instr.h"
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/SmallVector.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Type.h"
@@ -75,6 +77,20 @@ type getIntrinsicRetTy(IR::X86IntrinBinOp::Op);
 type getIntrinsicOp0Ty(IR::X86IntrinBinOp::Op);
 type getIntrinsicOp1Ty(IR::X86IntrinBinOp::Op);
 
-std::vector<type> getIntegerVectorTypes(type);
+type getIntrinsicRetTy(IR::X86IntrinTerOp::Op);
+type getIntrinsicOp0Ty(IR::X86IntrinTerOp::Op);
+type getIntrinsicOp1Ty(IR::X86IntrinTerOp::Op);
+type getIntrinsicOp2Ty(IR::X86IntrinTerOp::Op);
+
+// intrinsics whose return value is `width` bits wide, in enum order. the
+// tables are built once from the intrinsic shapes.
+llvm::ArrayRef<IR::X86IntrinBinOp::Op> getIntrinsicsByRetWidth(unsigned width);
+llvm::ArrayRef<IR::X86IntrinTerOp::Op>
+getTerIntrinsicsByRetWidth(unsigned width);
+
+// there are at most four lane shapes for a width, keep them inline
+using WorkTypes = llvm::SmallVector<type, 4>;
+
+WorkTypes getIntegerVectorTypes(type);
 
 } // namespace minotaur
\ No newline at end of file
@@ -2,16 +2,51 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 #pragma once
 #include <unordered_set>
+#include "llvm/IR/FMF.h"
 #include "llvm/IR/Function.h"
+#include "llvm/IR/IRBuilder.h"
 
 struct redisContext;
 
 namespace minotaur {
+// redis list holding the keys of cuts that are waiting for offline synthesis
+constexpr const char *PENDING_QUEUE = "minotaur-pending";
+
+
 void eliminate_dead_code(llvm::Function &F);
 
+// the target-cpu and target-features attributes of From are set on To, so
+// that a cut is synthesized for the target of the function it comes from
+void copy_target_attributes(const llvm::Function &From, llvm::Function &To);
+
+// the fast-math flags every floating point operation of F carries, none if
+// F has no floating point operation
+llvm::FastMathFlags common_fast_math_flags(const llvm::Function &F);
+
+// the name of the and masking the root of a cut to its demanded bits
+constexpr const char *DEMANDED = "__demanded";
+
+// the value a cut of several roots returns: the roots, all of one type,
+// concatenated into a vector in order. the instructions doing so are named
+// __roots, there must be a power of two of roots
+llvm::Value *concat_roots(llvm::IRBuilderBase &B,
+                          llvm::ArrayRef<llvm::Value*> Roots);
+
+// the roots concatenated by the result of concat_roots, or V on its own.
+// roots masked to their demanded bits are given unmasked
+llvm::SmallVector<llvm::Value*, 4> cut_roots(llvm::Value *V);
+
+// the i-th root of type Ty out of the concatenation V
+llvm::Value *extract_root(llvm::IRBuilderBase &B, llvm::Value *V,
+                          llvm::Type *Ty, unsigned i);
+
+// peak resident set size of the process in KB
+size_t peak_rss();
+
 bool hGet(const char* s, unsigned sz, std::string &Value, redisContext *c);
 void hSetRewrite(const char*, unsigned, const char *, unsigned, llvm::StringRef,
                  redisContext *c, unsigned, unsigned, llvm::StringRef);
 void hSetNoSolution(const char*, unsigned, redisContext *c, llvm::StringRef);
-void removeUnusedDecls(std::unordered_set<llvm::Function *>);
+bool hSetPending(const char*, unsigned, redisContext *c, llvm::StringRef,
+                 bool force = false);
 }
\ No newline at end of file
@@ -21,6 +21,7 @@
 #include "llvm/Support/TypeSize.h"
 
 #include <map>
+#include <mutex>
 #include <sstream>
 #include <unordered_map>
 
@@ -60,8 +61,22 @@ void calculateAndInitConstants(Transform &t);
 
 namespace minotaur {
 
+// alive2 keeps its configuration, the smt context and the symbolic execution
+// state in globals, so queries from concurrent slices must be serialized.
+// the configuration of the calling context is installed under the lock.
+static std::mutex alive_lock;
+
+void AliveEngine::setConfig() const {
+  util::config::disable_undef_input = mctx.disable_undef_input;
+  util::config::disable_poison_input = dpi;
+  util::config::use_exact_fp = dpi;
+  smt::solver_print_queries(mctx.smt_verbose);
+}
+
 bool
 AliveEngine::compareFunctions(llvm::Function &Func1, llvm::Function &Func2) {
+  std::lock_guard<std::mutex> guard(alive_lock);
+  setConfig();
   smt::smt_initializer smt_init;
   llvm_util::Verifier verifier(TLI, smt_init, *debug);
   verifier.quiet = false;
@@ -234,6 +249,8 @@ static const llvm::fltSemantics &getFloatSemantics(unsigned BitWidth) {
 bool
 AliveEngine::constantSynthesis(llvm::Function &src, llvm::Function &tgt,
    unordered_map<llvm::Argument*, llvm::Constant*>& ConstMap) {
+  std::lock_guard<std::mutex> guard(alive_lock);
+  setConfig();
 
   std::optional<smt::smt_initializer> smt_init;
   smt_init.emplace();
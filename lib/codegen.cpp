@@ -25,11 +25,14 @@ using namespace llvm;
 
 namespace {
 struct debug {
+const minotaur::MinotaurContext &mctx;
+debug(const minotaur::MinotaurContext &mctx) : mctx(mctx) {}
+
 template<class T>
 debug &operator<<(const T &s)
 {
-  if (minotaur::config::debug_codegen)
-    minotaur::config::dbg() << s;
+  if (mctx.debug_codegen)
+    mctx.dbg() << s;
   return *this;
 }
 };
@@ -63,7 +66,7 @@ llvm::Value *LLVMGen::bitcastTo(llvm::Value *V, llvm::Type *to) {
   if (auto BC = dyn_cast<BitCastInst>(V)) {
     V = BC->getOperand(0);
   }
-  debug() << "bitcastTo: " << *V << " to " << *to << "\n";
+  debug(mctx) << "bitcastTo: " << *V << " to " << *to << "\n";
   return b.CreateBitCast(V, to);
 }
 
@@ -112,17 +115,49 @@ LLVMGen::codeGenImpl(Inst *I, ValueToValueMapTy &VMap) {
     case UnaryOp::fround:     iid = Intrinsic::round;      break;
     case UnaryOp::froundeven: iid = Intrinsic::roundeven;  break;
     case UnaryOp::ftrunc:     iid = Intrinsic::trunc;      break;
+    case UnaryOp::abs:        iid = Intrinsic::abs;        break;
     default: UNREACHABLE();
     }
 
     CallInst *CI = nullptr;
-    if (K == UnaryOp::ctlz || K == UnaryOp::cttz) {
+    if (K == UnaryOp::ctlz || K == UnaryOp::cttz || K == UnaryOp::abs) {
       CI = b.CreateBinaryIntrinsic(iid, op0, b.getFalse());
     } else {
       CI = b.CreateUnaryIntrinsic(iid, op0);
     }
     IntrinsicDecls.insert(CI->getCalledFunction());
     return CI;
+  } else if (auto R = dynamic_cast<Reduction*>(I)) {
+    type workty = R->getWorkTy();
+    auto op0 = codeGenImpl(R->V(), VMap);
+    if(!R->V()->getType().same_width(workty))
+      report_fatal_error("operand width mismatch");
+    op0 = bitcastTo(op0, workty.toLLVM(C));
+    Type *ety = workty.getAsScalar().toLLVM(C);
+
+    CallInst *CI = nullptr;
+    switch (R->K()) {
+    case Reduction::add:  CI = b.CreateAddReduce(op0);                break;
+    case Reduction::mul:  CI = b.CreateMulReduce(op0);                break;
+    case Reduction::band: CI = b.CreateAndReduce(op0);                break;
+    case Reduction::bor:  CI = b.CreateOrReduce(op0);                 break;
+    case Reduction::bxor: CI = b.CreateXorReduce(op0);                break;
+    case Reduction::smax: CI = b.CreateIntMaxReduce(op0, true);       break;
+    case Reduction::smin: CI = b.CreateIntMinReduce(op0, true);       break;
+    case Reduction::umax: CI = b.CreateIntMaxReduce(op0, false);      break;
+    case Reduction::umin: CI = b.CreateIntMinReduce(op0, false);      break;
+    // the ordered fp reductions start from the identity
+    case Reduction::fadd:
+      CI = b.CreateFAddReduce(ConstantFP::getNegativeZero(ety), op0);
+      break;
+    case Reduction::fmul:
+      CI = b.CreateFMulReduce(ConstantFP::get(ety, 1.0), op0);
+      break;
+    case Reduction::fmax: CI = b.CreateFPMaxReduce(op0);              break;
+    case Reduction::fmin: CI = b.CreateFPMinReduce(op0);              break;
+    }
+    IntrinsicDecls.insert(CI->getCalledFunction());
+    return CI;
   } else if (auto U = dynamic_cast<Copy*>(I)) {
     auto op0 = codeGenImpl(U->V(), VMap);
     return op0;
@@ -170,6 +205,26 @@ LLVMGen::codeGenImpl(Inst *I, ValueToValueMapTy &VMap) {
       break;
     }
     return r;
+  } else if (auto T = dynamic_cast<TernaryOp*>(I)) {
+    type workty = T->getWorkTy();
+    minotaur::Value *ops[3] = { T->A(), T->B(), T->C() };
+    llvm::Value *args[3];
+    for (unsigned i = 0; i < 3; ++i) {
+      if (!workty.same_width(ops[i]->getType()))
+        report_fatal_error("operand width mismatch");
+      args[i] = bitcastTo(codeGenImpl(ops[i], VMap), workty.toLLVM(C));
+    }
+    Intrinsic::ID iid;
+    switch (T->K()) {
+    case TernaryOp::fshl:    iid = Intrinsic::fshl;    break;
+    case TernaryOp::fshr:    iid = Intrinsic::fshr;    break;
+    case TernaryOp::fma:     iid = Intrinsic::fma;     break;
+    case TernaryOp::fmuladd: iid = Intrinsic::fmuladd; break;
+    default: UNREACHABLE();
+    }
+    CallInst *CI = b.CreateIntrinsic(iid, {args[0]->getType()}, args);
+    IntrinsicDecls.insert(CI->getCalledFunction());
+    return CI;
   } else if (auto B = dynamic_cast<BinaryOp*>(I)) {
     type workty = B->getWorkTy();
     auto op0 = codeGenImpl(B->L(), VMap);
@@ -193,8 +248,19 @@ LLVMGen::codeGenImpl(Inst *I, ValueToValueMapTy &VMap) {
     case BinaryOp::umin:       iid = Intrinsic::umin;       break;
     case BinaryOp::smax:       iid = Intrinsic::smax;       break;
     case BinaryOp::smin:       iid = Intrinsic::smin;       break;
+    case BinaryOp::uadd_sat:   iid = Intrinsic::uadd_sat;   break;
+    case BinaryOp::sadd_sat:   iid = Intrinsic::sadd_sat;   break;
+    case BinaryOp::usub_sat:   iid = Intrinsic::usub_sat;   break;
+    case BinaryOp::ssub_sat:   iid = Intrinsic::ssub_sat;   break;
     default: break;
     }
+    // a rotate is a funnel shift of a value with itself
+    if (B->K() == BinaryOp::rotl || B->K() == BinaryOp::rotr) {
+      iid = B->K() == BinaryOp::rotl ? Intrinsic::fshl : Intrinsic::fshr;
+      CallInst *C = b.CreateIntrinsic(iid, {op0->getType()}, {op0, op0, op1});
+      IntrinsicDecls.insert(C->getCalledFunction());
+      return C;
+    }
     if (iid) {
       CallInst *C = b.CreateBinaryIntrinsic(iid, op0, op1);
       IntrinsicDecls.insert(C->getCalledFunction());
@@ -254,6 +320,18 @@ LLVMGen::codeGenImpl(Inst *I, ValueToValueMapTy &VMap) {
     default:
       UNREACHABLE();
     }
+    // the builder folds constant operands
+    if (auto *BI = dyn_cast<Instruction>(r)) {
+      unsigned flags = B->getFlags();
+      if (flags & BinaryOp::nuw)
+        BI->setHasNoUnsignedWrap(true);
+      if (flags & BinaryOp::nsw)
+        BI->setHasNoSignedWrap(true);
+      if (flags & BinaryOp::exact)
+        BI->setIsExact(true);
+      if (flags & BinaryOp::disjoint)
+        cast<PossiblyDisjointInst>(BI)->setIsDisjoint(true);
+    }
     return r;
   } else if (auto IC = dynamic_cast<ICmp*>(I)) {
     auto op0 = codeGenImpl(IC->L(), VMap);
@@ -379,7 +457,25 @@ LLVMGen::codeGenImpl(Inst *I, ValueToValueMapTy &VMap) {
                                        "intr",
                                        cast<Instruction>(b.GetInsertPoint()));
     return CI;
-  // TODO: handle terop
+  } else if (auto T = dynamic_cast<SIMDTerOpInst*>(I)) {
+    type op_tys[3] = { getIntrinsicOp0Ty(T->K()), getIntrinsicOp1Ty(T->K()),
+                       getIntrinsicOp2Ty(T->K()) };
+    minotaur::Value *ops[3] = { T->A(), T->B(), T->C() };
+    llvm::Value *args[3];
+    for (unsigned i = 0; i < 3; ++i) {
+      if (!op_tys[i].same_width(ops[i]->getType()))
+        report_fatal_error("operand width mismatch");
+      args[i] = bitcastTo(codeGenImpl(ops[i], VMap), op_tys[i].toLLVM(C));
+    }
+
+    llvm::Function *decl = Intrinsic::getDeclaration(M, getIntrinsicID(T->K()));
+    IntrinsicDecls.insert(decl);
+
+    llvm::Value *CI = CallInst::Create(decl,
+                                       ArrayRef<llvm::Value *>(args),
+                                       "intr",
+                                       cast<Instruction>(b.GetInsertPoint()));
+    return CI;
   } else if (auto FSV = dynamic_cast<FakeShuffleInst*>(I)) {
     auto op0 = codeGenImpl(FSV->L(), VMap);
     llvm::Type *op_ty = FSV->getInputTy().toLLVM(C);
@@ -5,11 +5,13 @@
 #include "cost-command.h"
 
 #include "llvm/ADT/ArrayRef.h"
+#include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/InstrTypes.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Module.h"
 #include "llvm/Support/Casting.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/ValueMapper.h"
@@ -94,66 +96,122 @@ unsigned get_machine_cost(Function *F) {
   return cycle;
 }
 
-unsigned get_approx_cost(llvm::Function *F) {
-  unsigned cost = 0;
-  for (auto &BB : *F) {
-    for (auto &I : BB) {
-      if (isa<Argument>(&I)) {
-        cost += 1;
-        // reserved const
-      } else if (CallInst *CI = dyn_cast<CallInst>(&I)) {
-        auto CalledF = CI->getCalledFunction();
-        if (CalledF) {
-          if (CalledF->getName().starts_with("__fksv")) {
-            cost += 4;
-          } else if (CalledF->isIntrinsic()){
-            if (CalledF->getIntrinsicID() == Intrinsic::minnum ||
-                CalledF->getIntrinsicID() == Intrinsic::minimum ||
-                CalledF->getIntrinsicID() == Intrinsic::maxnum ||
-                CalledF->getIntrinsicID() == Intrinsic::maximum) {
-              cost += 30;
-            } else {
-              cost += 2;
-            }
-          } else {
-            cost += 2;
-          }
-        } else {
-          cost += 2;
-        }
-      } else if (Instruction *BO = dyn_cast<Instruction>(&I)) {
-        auto opCode = BO->getOpcode();
-        if (opCode == Instruction::UDiv || opCode == Instruction::SDiv ||
-            opCode == Instruction::URem || opCode == Instruction::SRem) {
-          cost += 10;
-        } else if (opCode == Instruction::Mul) {
-          cost += 4;
-        } else if (opCode == Instruction::FAdd || opCode == Instruction::FSub ||
-                   opCode == Instruction::FMul) {
-          cost += 30;
-        } else if (opCode == Instruction::FDiv || opCode == Instruction::FRem) {
-          cost += 80;
-        } else if (opCode == Instruction::FNeg) {
-          cost += 2;
-        } else if (opCode == Instruction::BitCast) {
-          cost += 1;
-        } else if (opCode == Instruction::Unreachable ||
-                   opCode == Instruction::Ret) {
-          cost += 0;
-        } else if (opCode ==Instruction::Select) {
-          cost += 4;
-        } else if (opCode == Instruction::InsertElement ||
-                   opCode == Instruction::ExtractElement ||
-                   opCode == Instruction::ShuffleVector) {
-          cost += 4;
+// a reduction is a tree of log2(lanes) shuffles and operations. without
+// reassoc, a floating point add or mul reduction is ordered and takes one
+// extract and one operation per lane after the first
+static unsigned get_reduce_cost(CallInst *CI) {
+  unsigned step = 0;
+  bool ordered = false;
+  switch (CI->getIntrinsicID()) {
+  case Intrinsic::vector_reduce_add:
+  case Intrinsic::vector_reduce_and:
+  case Intrinsic::vector_reduce_or:
+  case Intrinsic::vector_reduce_xor:
+  case Intrinsic::vector_reduce_smax:
+  case Intrinsic::vector_reduce_smin:
+  case Intrinsic::vector_reduce_umax:
+  case Intrinsic::vector_reduce_umin:
+    step = 2;
+    break;
+  case Intrinsic::vector_reduce_mul:
+    step = 4;
+    break;
+  case Intrinsic::vector_reduce_fadd:
+  case Intrinsic::vector_reduce_fmul:
+    step = 30;
+    ordered = !CI->hasAllowReassoc();
+    break;
+  case Intrinsic::vector_reduce_fmax:
+  case Intrinsic::vector_reduce_fmin:
+    step = 30;
+    break;
+  default:
+    return 0;
+  }
+  auto *VT = cast<FixedVectorType>(
+    CI->getArgOperand(CI->arg_size() - 1)->getType());
+  if (ordered)
+    return (VT->getNumElements() - 1) * (step + 4);
+  return Log2_32_Ceil(VT->getNumElements()) * (step + 4);
+}
+
+unsigned get_approx_cost(llvm::Instruction *I) {
+  if (CallInst *CI = dyn_cast<CallInst>(I)) {
+    auto CalledF = CI->getCalledFunction();
+    if (CalledF) {
+      if (CalledF->getName().starts_with("__fksv")) {
+        return 4;
+      } else if (CalledF->isIntrinsic()){
+        if (unsigned rc = get_reduce_cost(CI)) {
+          return rc;
+        } else if (CalledF->getIntrinsicID() == Intrinsic::fshl ||
+                   CalledF->getIntrinsicID() == Intrinsic::fshr) {
+          // one rol/ror or shld/shrd, below the two shifts and the or it
+          // takes otherwise
+          return 3;
+        } else if (CalledF->getIntrinsicID() == Intrinsic::abs) {
+          // a negation and a select without a native abs
+          return 3;
+        } else if (CalledF->getIntrinsicID() == Intrinsic::uadd_sat ||
+                   CalledF->getIntrinsicID() == Intrinsic::sadd_sat ||
+                   CalledF->getIntrinsicID() == Intrinsic::usub_sat ||
+                   CalledF->getIntrinsicID() == Intrinsic::ssub_sat) {
+          // native on vectors, an overflow check and a select otherwise
+          return 4;
+        } else if (CalledF->getIntrinsicID() == Intrinsic::fma ||
+                   CalledF->getIntrinsicID() == Intrinsic::fmuladd) {
+          // one floating point operation in place of two
+          return 30;
+        } else if (CalledF->getIntrinsicID() == Intrinsic::minnum ||
+            CalledF->getIntrinsicID() == Intrinsic::minimum ||
+            CalledF->getIntrinsicID() == Intrinsic::maxnum ||
+            CalledF->getIntrinsicID() == Intrinsic::maximum) {
+          return 30;
         } else {
-          cost += 2;
+          return 2;
         }
       } else {
-        cost += 2;
+        return 2;
       }
+    } else {
+      return 2;
     }
   }
+
+  auto opCode = I->getOpcode();
+  if (opCode == Instruction::UDiv || opCode == Instruction::SDiv ||
+      opCode == Instruction::URem || opCode == Instruction::SRem) {
+    return 10;
+  } else if (opCode == Instruction::Mul) {
+    return 4;
+  } else if (opCode == Instruction::FAdd || opCode == Instruction::FSub ||
+             opCode == Instruction::FMul) {
+    return 30;
+  } else if (opCode == Instruction::FDiv || opCode == Instruction::FRem) {
+    return 80;
+  } else if (opCode == Instruction::FNeg) {
+    return 2;
+  } else if (opCode == Instruction::BitCast) {
+    return 1;
+  } else if (opCode == Instruction::Unreachable ||
+             opCode == Instruction::Ret) {
+    return 0;
+  } else if (opCode ==Instruction::Select) {
+    return 4;
+  } else if (opCode == Instruction::InsertElement ||
+             opCode == Instruction::ExtractElement ||
+             opCode == Instruction::ShuffleVector) {
+    return 4;
+  } else {
+    return 2;
+  }
+}
+
+unsigned get_approx_cost(llvm::Function *F) {
+  unsigned cost = 0;
+  for (auto &BB : *F)
+    for (auto &I : BB)
+      cost += get_approx_cost(&I);
   return cost;
 }
 
@@ -5,6 +5,8 @@
 #include "enumerator.h"
 #include "expr.h"
 #include "codegen.h"
+#include "lanes.h"
+#include "sketch.h"
 #include "cost.h"
 #include "utils.h"
 #include "type.h"
@@ -22,7 +24,9 @@
 #include "llvm_util/utils.h"
 
 #include "llvm/ADT/Statistic.h"
+#include "llvm/Analysis/AssumptionCache.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
+#include "llvm/Analysis/DemandedBits.h"
 #include "llvm/Analysis/LoopAnalysisManager.h"
 #include "llvm/Analysis/ScalarEvolutionExpressions.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
@@ -37,15 +41,19 @@
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/TargetParser/Triple.h"
 #include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/Local.h"
 #include "llvm/Support/KnownBits.h"
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
 #include <iostream>
 #include <memory>
 #include <queue>
 #include <vector>
 #include <set>
 #include <map>
+#include <tuple>
 
 using namespace tools;
 using namespace util;
@@ -54,11 +62,14 @@ using namespace IR;
 
 namespace {
 struct debug {
+const minotaur::MinotaurContext &mctx;
+debug(const minotaur::MinotaurContext &mctx) : mctx(mctx) {}
+
 template<class T>
 debug &operator<<(const T &s)
 {
-if (minotaur::config::debug_enumerator)
-  minotaur::config::dbg() << s;
+if (mctx.debug_enumerator)
+  mctx.dbg() << s;
 return *this;
 }
 };
@@ -72,12 +83,27 @@ void Enumerator::findInputs(llvm::Function &F,
                             llvm::DominatorTree &DT) {
   for (auto &A : F.args()) {
     auto T = make_unique<Var>(&A);
-    values.emplace_back(T.get());
+    inputs.emplace_back(T.get());
     exprs.emplace_back(std::move(T));
   }
+  // the roots of a cut of several roots, and what is computed from them, are
+  // no inputs of its rewrite
+  unordered_set<llvm::Value*> Outputs;
+  vector<llvm::Value*> Worklist;
+  for (auto *R : cut_roots(root))
+    Worklist.push_back(R);
+  while (!Worklist.empty()) {
+    llvm::Value *V = Worklist.back();
+    Worklist.pop_back();
+    if (!Outputs.insert(V).second)
+      continue;
+    for (auto *U : V->users())
+      Worklist.push_back(U);
+  }
+
   for (auto &BB : F) {
     for (auto &I : BB) {
-      if (&I == root)
+      if (&I == root || Outputs.count(&I))
         continue;
 
       auto ty = I.getType()->getScalarType();
@@ -88,20 +114,100 @@ void Enumerator::findInputs(llvm::Function &F,
         continue;
 
       auto T = make_unique<Var>(&I);
-      values.emplace_back(T.get());
+      inputs.emplace_back(T.get());
       exprs.emplace_back(std::move(T));
     }
   }
+  rankInputs(root, DT);
+}
+
+// sketches are built over pairs and triples of inputs, so the enumerator
+// starts from the inputs most likely to appear in a rewrite:
+// + inputs with live bits, bits that are neither known nor unused by the
+//   slice, as computed by KnownBits and DemandedBits
+// + closer to the root in the dependence graph
+// + of the same width as the root, then of the same lane count or element
+//   width
+// + more live bits
+void Enumerator::rankInputs(llvm::Instruction *root,
+                            llvm::DominatorTree &DT) {
+  unordered_map<llvm::Value*, unsigned> Dist = {{root, 0}};
+  queue<llvm::Instruction*> Q;
+  Q.push(root);
+  while (!Q.empty()) {
+    auto *I = Q.front();
+    Q.pop();
+    for (auto &Op : I->operands()) {
+      if (!isa<llvm::Instruction>(Op) && !isa<llvm::Argument>(Op))
+        continue;
+      if (!Dist.try_emplace(Op, Dist[I] + 1).second)
+        continue;
+      if (auto *OpI = dyn_cast<llvm::Instruction>(Op))
+        Q.push(OpI);
+    }
+  }
+
+  const llvm::DataLayout &DL = root->getModule()->getDataLayout();
+  auto *RootTy = root->getType();
+  llvm::Function &F = *root->getFunction();
+  llvm::AssumptionCache AC(F);
+  llvm::DemandedBits DB(F, AC, DT);
+
+  struct Rank {
+    bool Dead;
+    unsigned Dist;
+    unsigned Compat;
+    unsigned Live;
+  };
+  unordered_map<Var*, Rank> Ranks;
+  for (auto *In : inputs) {
+    llvm::Value *V = In->V();
+    auto *Ty = V->getType();
+
+    unsigned Live = Ty->getScalarSizeInBits();
+    if (Ty->isIntOrIntVectorTy()) {
+      llvm::KnownBits Known = computeKnownBits(V, DL);
+      llvm::APInt Demanded = llvm::APInt::getZero(Live);
+      if (auto *I = dyn_cast<llvm::Instruction>(V)) {
+        Demanded = DB.getDemandedBits(I);
+      } else {
+        for (auto &U : V->uses())
+          Demanded |= DB.getDemandedBits(&U);
+      }
+      Live = (Demanded & ~(Known.Zero | Known.One)).popcount();
+    }
+
+    auto It = Dist.find(V);
+    unsigned D = It == Dist.end() ? UINT_MAX : It->second;
+
+    unsigned Compat = 2;
+    if (Ty->getPrimitiveSizeInBits() == RootTy->getPrimitiveSizeInBits())
+      Compat = 0;
+    else if (Ty->getScalarSizeInBits() == RootTy->getScalarSizeInBits() ||
+             In->getType().getLane() == type(RootTy).getLane())
+      Compat = 1;
+
+    Ranks[In] = {Live == 0, D, Compat, Live};
+  }
+
+  std::stable_sort(inputs.begin(), inputs.end(), [&Ranks](Var *A, Var *B) {
+    auto &RA = Ranks[A], &RB = Ranks[B];
+    return make_tuple(RA.Dead, RA.Dist, RA.Compat, RB.Live) <
+           make_tuple(RB.Dead, RB.Dist, RB.Compat, RA.Live);
+  });
 }
 
-bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
+// builds the sketches over values, the placeholders of a template
+static void buildSketches(const vector<Var*> &values, type expected,
+                          const TargetFeatures &features,
+                          llvm::FastMathFlags FMF,
+                          vector<Sketch> &sketches,
+                          vector<unique_ptr<Inst>> &exprs) {
   vector<Value*> Comps;
   for (auto &I : values) {
     Comps.emplace_back(I);
   }
 
-  type expected{V->getType()};
-
   // casts
   for (auto Comp : Comps) {
     auto Op = dynamic_cast<Var*>(Comp);
@@ -112,8 +218,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
     if (Op->getType().same_width(expected))
       continue;
 
-    vector<type> tys = getIntegerVectorTypes(Op->getType());
-    for (auto workty : tys) {
+    for (auto workty : getIntegerVectorTypes(Op->getType())) {
       unsigned op_bits = workty.getBits();
       unsigned lane = workty.getLane();
       if (expected.getWidth() % lane != 0)
@@ -199,13 +304,19 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
   }
 
   // unop
+  // the work types only depend on the expected type, compute them once
+  vector<pair<UnaryOp::Op, WorkTypes>> UnaryWorkTys;
+  for (unsigned K = UnaryOp::bitreverse; K <= UnaryOp::abs; ++K) {
+    UnaryOp::Op opcode = static_cast<UnaryOp::Op>(K);
+    auto tys = getUnaryOpWorkTypes(expected, opcode);
+    if (!tys.empty())
+      UnaryWorkTys.emplace_back(opcode, std::move(tys));
+  }
+
   for (auto Op0 : Comps) {
     if (!expected.same_width(Op0->getType()))
       continue;
-    for (unsigned K = UnaryOp::bitreverse; K <= UnaryOp::ftrunc; ++K) {
-      UnaryOp::Op opcode = static_cast<UnaryOp::Op>(K);
-      vector<type> tys = getUnaryOpWorkTypes(expected, opcode);
-
+    for (auto &[opcode, tys] : UnaryWorkTys) {
       for (auto workty : tys) {
         set<ReservedConst*> RCs;
         auto U = make_unique<UnaryOp>(opcode, *Op0, workty);
@@ -242,17 +353,53 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
     exprs.emplace_back(std::move(EE));
   }
 
+  // reductions, the expected scalar is one lane of the input
+  if (expected.getLane() == 1) {
+    unsigned bits = expected.getBits();
+    for (auto Op0 : Comps) {
+      auto op0_ty = Op0->getType();
+      if (op0_ty.getWidth() <= bits || op0_ty.getWidth() % bits)
+        continue;
+      if (expected.isFP() && (!op0_ty.isFP() || op0_ty.getBits() != bits))
+        continue;
+      type workty = type::Vectorizable(op0_ty.getWidth() / bits, bits,
+                                       expected.isFP());
+      for (unsigned K = Reduction::add; K <= Reduction::fmin; ++K) {
+        auto opcode = static_cast<Reduction::Op>(K);
+        if (Reduction::isFloatingPoint(opcode) != expected.isFP())
+          continue;
+        // the others are the same as and, or and xor on i1
+        if (bits == 1 && !Reduction::isLogical(opcode))
+          continue;
+        set<ReservedConst*> RCs;
+        auto R = make_unique<Reduction>(opcode, *Op0, workty);
+        sketches.push_back(make_pair(R.get(), std::move(RCs)));
+        exprs.emplace_back(std::move(R));
+      }
+    }
+  }
+
   auto RC1 = make_unique<ReservedConst>(type::Null());
   Comps.emplace_back(RC1.get());
 
   // binop
-  for (unsigned K = BinaryOp::band; K <= BinaryOp::copysign; ++K) {
+  for (unsigned K = BinaryOp::band; K <= BinaryOp::rotr; ++K) {
     BinaryOp::Op Op = static_cast<BinaryOp::Op>(K);
 
     if (expected.getBits() == 1 && !BinaryOp::isLogical(Op)) {
       continue;
     }
 
+    // without nans and signed zeros, fmaximum and fminimum are fmaxnum and
+    // fminnum
+    if ((Op == BinaryOp::fmaximum || Op == BinaryOp::fminimum) &&
+        FMF.noNaNs() && FMF.noSignedZeros())
+      continue;
+
+    auto worktys = getBinaryOpWorkTypes(expected, Op);
+    if (worktys.empty())
+      continue;
+
     for (auto Op0 = Comps.begin(); Op0 != Comps.end(); ++Op0) {
 
       auto Op1 = Comps.begin();
@@ -263,7 +410,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
 
       for (; Op1 != Comps.end(); ++Op1) {
 
-        for (auto workty : getBinaryOpWorkTypes(expected, Op)) {
+        for (auto workty : worktys) {
           Value *I = nullptr, *J = nullptr;
           set<ReservedConst*> RCs;
 
@@ -314,6 +461,88 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
     }
   }
 
+  // funnel shifts of two different inputs, the rotates are binary operations.
+  // the shift amount is either an input or a constant
+  for (unsigned K = TernaryOp::fshl; K <= TernaryOp::fshr; ++K) {
+    TernaryOp::Op Op = static_cast<TernaryOp::Op>(K);
+    auto worktys = getTernaryOpWorkTypes(expected, Op);
+    if (worktys.empty())
+      continue;
+
+    for (auto Op0 : Comps) {
+      for (auto Op1 : Comps) {
+        if (Op0 == Op1 || dynamic_cast<ReservedConst*>(Op0) ||
+            dynamic_cast<ReservedConst*>(Op1))
+          continue;
+        if (!expected.same_width(Op0->getType()) ||
+            !expected.same_width(Op1->getType()))
+          continue;
+        for (auto Op2 : Comps) {
+          bool IsConst = dynamic_cast<ReservedConst*>(Op2);
+          if (!IsConst && !expected.same_width(Op2->getType()))
+            continue;
+          for (auto workty : worktys) {
+            set<ReservedConst*> RCs;
+            Value *Amt = Op2;
+            if (IsConst) {
+              auto T = make_unique<ReservedConst>(workty);
+              Amt = T.get();
+              RCs.insert(T.get());
+              exprs.emplace_back(std::move(T));
+            }
+            auto TO = make_unique<TernaryOp>(Op, *Op0, *Op1, *Amt, workty);
+            sketches.push_back(make_pair(TO.get(), std::move(RCs)));
+            exprs.emplace_back(std::move(TO));
+          }
+        }
+      }
+    }
+  }
+
+  // (fma a b c) computes a * b + c with a single rounding, fmuladd may round
+  // once or twice, which is what a contracted fmul and fadd allow. the
+  // product is commutative and at most one operand is a constant
+  for (unsigned K = TernaryOp::fma; K <= TernaryOp::fmuladd; ++K) {
+    TernaryOp::Op Op = static_cast<TernaryOp::Op>(K);
+    auto worktys = getTernaryOpWorkTypes(expected, Op);
+    if (worktys.empty())
+      continue;
+
+    for (auto Op0 = Comps.begin(); Op0 != Comps.end(); ++Op0) {
+      if (dynamic_cast<ReservedConst*>(*Op0) ||
+          !expected.same_width((*Op0)->getType()))
+        continue;
+      for (auto Op1 = Op0; Op1 != Comps.end(); ++Op1) {
+        bool ConstMul = dynamic_cast<ReservedConst*>(*Op1);
+        if (!ConstMul && !expected.same_width((*Op1)->getType()))
+          continue;
+        for (auto Op2 : Comps) {
+          bool ConstAdd = dynamic_cast<ReservedConst*>(Op2);
+          if (ConstMul && ConstAdd)
+            continue;
+          if (!ConstAdd && !expected.same_width(Op2->getType()))
+            continue;
+          for (auto workty : worktys) {
+            set<ReservedConst*> RCs;
+            auto bind = [&](Value *V) -> Value* {
+              if (!dynamic_cast<ReservedConst*>(V))
+                return V;
+              auto T = make_unique<ReservedConst>(workty);
+              V = T.get();
+              RCs.insert(T.get());
+              exprs.emplace_back(std::move(T));
+              return V;
+            };
+            Value *B = bind(*Op1), *C = bind(Op2);
+            auto TO = make_unique<TernaryOp>(Op, **Op0, *B, *C, workty);
+            sketches.push_back(make_pair(TO.get(), std::move(RCs)));
+            exprs.emplace_back(std::move(TO));
+          }
+        }
+      }
+    }
+  }
+
   //icmps
   if (expected.getWidth() <= 64) {
     unsigned lanes = expected.getWidth();
@@ -425,6 +654,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
   }
 
   // insertelement
+  auto InsertWorkTys = getInsertElementWorkTypes(expected);
   for (auto Op0 : Comps) {
     for (auto Op1 : Comps) {
       if (dynamic_cast<ReservedConst*>(Op1)) {
@@ -432,8 +662,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
         auto v_ty = Op0->getType();
         if (v_ty.getWidth() != expected.getWidth())
           continue;
-        auto worktys = getInsertElementWorkTypes(expected);
-        for (auto ty : worktys) {
+        for (auto ty : InsertWorkTys) {
           set<ReservedConst*> RCs;
           auto T1 = make_unique<ReservedConst>(ty.getAsScalar());
           Value *Elm = T1.get();
@@ -494,20 +723,16 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
   }
 
   // BinaryIntrinsics
-  for (unsigned K = 0; K < X86IntrinBinOp::numOfX86Intrinsics; ++K) {
-    if (expected.isFP())
+  // only the intrinsics returning the expected width are visited
+  llvm::ArrayRef<X86IntrinBinOp::Op> Intrinsics;
+  if (!expected.isFP())
+    Intrinsics = getIntrinsicsByRetWidth(expected.getWidth());
+  for (X86IntrinBinOp::Op op : Intrinsics) {
+    if (!features.supports(op))
       continue;
-    // typecheck for return val
-    X86IntrinBinOp::Op op = static_cast<X86IntrinBinOp::Op>(K);
-    if (config::disable_avx512 && SIMDBinOpInst::is512(op))
-      continue;
-    type ret_ty = getIntrinsicRetTy(op);
     type op0_ty = getIntrinsicOp0Ty(op);
     type op1_ty = getIntrinsicOp1Ty(op);
 
-    if (!ret_ty.same_width(expected))
-      continue;
-
     for (auto Op0 = Comps.begin(); Op0 != Comps.end(); ++Op0) {
       for (auto Op1 = Comps.begin(); Op1 != Comps.end(); ++Op1) {
         if (dynamic_cast<ReservedConst *>(*Op0) &&
@@ -547,7 +772,51 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
     }
   }
 
+  // TernaryIntrinsics
+  llvm::ArrayRef<X86IntrinTerOp::Op> TerIntrinsics;
+  if (!expected.isFP())
+    TerIntrinsics = getTerIntrinsicsByRetWidth(expected.getWidth());
+  for (X86IntrinTerOp::Op op : TerIntrinsics) {
+    if (!features.supports(op))
+      continue;
+    type op_tys[3] = { getIntrinsicOp0Ty(op), getIntrinsicOp1Ty(op),
+                       getIntrinsicOp2Ty(op) };
+
+    for (auto Op0 : Comps) {
+      for (auto Op1 : Comps) {
+        for (auto Op2 : Comps) {
+          Value *Ops[3] = { Op0, Op1, Op2 };
+          // at most one constant, and the inputs must match the shapes
+          unsigned NumRCs = 0;
+          bool Typed = true;
+          for (unsigned i = 0; i < 3; ++i) {
+            if (dynamic_cast<ReservedConst *>(Ops[i]))
+              ++NumRCs;
+            else if (!Ops[i]->getType().same_width(op_tys[i]))
+              Typed = false;
+          }
+          if (NumRCs > 1 || !Typed)
+            continue;
+
+          set<ReservedConst*> RCs;
+          for (unsigned i = 0; i < 3; ++i) {
+            if (!dynamic_cast<ReservedConst *>(Ops[i]))
+              continue;
+            auto T = make_unique<ReservedConst>(op_tys[i]);
+            Ops[i] = T.get();
+            RCs.insert(T.get());
+            exprs.emplace_back(std::move(T));
+          }
+          auto TI = make_unique<SIMDTerOpInst>(op, *Ops[0], *Ops[1], *Ops[2]);
+          sketches.push_back(make_pair(TI.get(), std::move(RCs)));
+          exprs.emplace_back(std::move(TI));
+        }
+      }
+    }
+  }
+
   // shufflevector
+  auto ShuffleWorkTys = getShuffleWorkTypes(expected);
   for (auto Op0 = Comps.begin(); Op0 != Comps.end(); ++Op0) {
     // skip (sv rc, *, mask)
     if (dynamic_cast<ReservedConst *>(*Op0))
@@ -559,8 +828,7 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
     if (expected.isFP() ^ op_ty.isFP())
       continue;
 
-    auto tys = getShuffleWorkTypes(expected);
-    for (auto ty : tys) {
+    for (auto ty : ShuffleWorkTys) {
       if (ty.getLane() == 1)
         continue;
       type mask_ty = type::IntegerVectorizable(ty.getLane(), 32);
@@ -670,29 +938,179 @@ bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches) {
       }
     }
   }
+}
+
+// slices with the same input and root types share their sketches. the
+// inputs are bound to the slots of the template ordered by type, so that
+// permutations of the same types hit the same template.
+bool Enumerator::getSketches(llvm::Value *V, vector<Sketch> &sketches,
+                             Tier Only) {
+  type expected{V->getType()};
+
+  vector<Var*> bound(values);
+  std::stable_sort(bound.begin(), bound.end(), [](Var *A, Var *B) {
+    type TA = A->getType(), TB = B->getType();
+    return make_tuple(TA.getBits(), TA.getLane(), TA.isFP()) <
+           make_tuple(TB.getBits(), TB.getLane(), TB.isFP());
+  });
+
+  auto &Cache = SketchCache::get();
+  string Key = SketchCache::key(bound, expected, features.key(), fmf);
+  auto T = Cache.lookup(Key);
+  if (!T) {
+    auto NewT = make_shared<SketchTemplate>();
+    for (auto *In : bound) {
+      auto P = make_unique<Var>("%_" + to_string(NewT->slots.size()),
+                                In->getType());
+      NewT->slots.push_back(P.get());
+      NewT->exprs.emplace_back(std::move(P));
+    }
+    buildSketches(NewT->slots, expected, features, fmf,
+                  NewT->sketches, NewT->exprs);
+    for (auto &S : NewT->sketches)
+      NewT->tiers.push_back(tierOf(S));
+    Cache.insert(Key, NewT);
+    T = std::move(NewT);
+    debug(mctx) << "[enumerator] new sketch template " << Key << "\n";
+  }
 
+  instantiate(*T, bound, sketches, exprs, Only);
   return true;
 }
 
-using Candidate = tuple<llvm::Function*, llvm::Function*, Inst*,
-                        unordered_map<const llvm::Argument*, ReservedConst*>,
-                        bool>;
+// a sketch that passed the cheap checks, and its approximate cost
+using Candidate = pair<Sketch*, unsigned>;
+
+// a copy of F in the scratch module taking the constants of a sketch as
+// extra arguments. the constants are named by their position, so that the
+// copies made for the source and the target of a query agree.
+static llvm::Function *withConstants(llvm::Function &F, llvm::Module &Scratch,
+                                     llvm::ArrayRef<llvm::Type*> ConstTys,
+                                     llvm::ValueToValueMapTy &VMap) {
+  auto FT = F.getFunctionType();
+  llvm::SmallVector<llvm::Type*, 8> Args(FT->params().begin(),
+                                         FT->params().end());
+  Args.append(ConstTys.begin(), ConstTys.end());
+
+  auto _functionType =
+    llvm::FunctionType::get(FT->getReturnType(), Args, FT->isVarArg());
+
+  llvm::Function *NewF =
+    llvm::Function::Create(_functionType, F.getLinkage(),
+                           F.getName(), Scratch);
+
+  llvm::Function::arg_iterator ArgI = NewF->arg_begin();
+  for (auto A = F.arg_begin(), E = F.arg_end(); A != E; ++A, ++ArgI) {
+    VMap[A] = ArgI;
+    ArgI->setName(A->getName());
+  }
+  for (unsigned i = 0; i < ConstTys.size(); ++i, ++ArgI)
+    ArgI->setName("_reservedc_" + std::to_string(i));
+
+  // the declarations are copied when the scratch module is made
+  for (auto &D : *F.getParent())
+    if (D.isDeclaration())
+      VMap[&D] = Scratch.getFunction(D.getName());
+
+  llvm::SmallVector<llvm::ReturnInst*, 8> _returns;
+  llvm::CloneFunctionInto(NewF, &F, VMap,
+    llvm::CloneFunctionChangeType::DifferentModule, _returns);
+  return NewF;
+}
+
+// the share of the budget, in percent, a tier may use up together with the
+// tiers before it. time left by a tier goes to the next one.
+static constexpr unsigned TierBudget[NumTiers] = { 10, 40, 70, 100 };
 
 static bool approx(const Candidate &f1, const Candidate &f2){
-  return get_approx_cost(get<0>(f1)) < get_approx_cost(get<0>(f2));
+  return f1.second < f2.second;
 }
 
-vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
-  unsigned CANDIDATES = 0, PRUNED = 0, GOOD = 0;
-  vector<Rewrite> ret;
+// the approximate cost of Fn once V replaces Root and the code left dead is
+// eliminated, Fn itself is not changed
+static unsigned costWith(llvm::Function &Fn, llvm::Instruction *Root,
+                         llvm::Value *V) {
+  set<llvm::Instruction*> Live;
+  vector<llvm::Instruction*> Worklist;
+  for (auto &BB : Fn)
+    for (auto &I : BB)
+      if (&I != Root && !llvm::wouldInstructionBeTriviallyDead(&I))
+        Worklist.push_back(&I);
+
+  unsigned Cost = 0;
+  while (!Worklist.empty()) {
+    llvm::Instruction *I = Worklist.back();
+    Worklist.pop_back();
+    if (!Live.insert(I).second)
+      continue;
+    Cost += get_approx_cost(I);
+    for (auto &Op : I->operands()) {
+      llvm::Value *O = Op.get() == Root ? V : Op.get();
+      if (auto *OI = dyn_cast<llvm::Instruction>(O))
+        Worklist.push_back(OI);
+    }
+  }
+  return Cost;
+}
 
-  debug() << "[enumerator] working on slice\n" << F << "\n";
+// gives every binary operation of a proven rewrite the strongest
+// poison-generating flags it still refines the slice with, one operation at
+// a time
+static void strengthenFlags(Inst *R, const function<bool(Inst*)> &Refines) {
+  vector<BinaryOp*> Ops;
+  set<Inst*> Seen;
+  vector<Inst*> Worklist = { R };
+  while (!Worklist.empty()) {
+    Inst *I = Worklist.back();
+    Worklist.pop_back();
+    if (!Seen.insert(I).second)
+      continue;
+    if (auto B = dynamic_cast<BinaryOp*>(I))
+      if (BinaryOp::allowedFlags(B->K()))
+        Ops.push_back(B);
+    for (auto *Op : operands(I))
+      Worklist.push_back(Op);
+  }
 
-  clock_t start = std::clock();
+  for (auto *B : Ops) {
+    unsigned Allowed = BinaryOp::allowedFlags(B->K());
+    // nuw and nsw together first, then each of them
+    for (unsigned Flags : { Allowed, Allowed & BinaryOp::nsw,
+                            Allowed & BinaryOp::nuw }) {
+      if (!Flags)
+        continue;
+      B->setFlags(Flags);
+      if (Refines(R))
+        break;
+      B->setFlags(0);
+    }
+  }
+}
+
+SolveStats Enumerator::solve(llvm::Function &F, llvm::Instruction *I,
+                             const RewriteCallback &OnRewrite,
+                             const CancelToken *Cancel) {
+  SolveStats Stats;
+  // a rewrite was reported, or the caller asked to stop
+  bool Found = false, Stop = false;
+
+  debug(mctx) << "[enumerator] working on slice\n" << F << "\n";
+
+  auto start = std::chrono::steady_clock::now();
 
   llvm::DominatorTree DT(F);
   DT.recalculate(F);
 
+  // candidates, and the declarations the code generator adds for them, are
+  // built in a scratch module that is dropped as a whole with the slice
+  llvm::Module Scratch("scratch", F.getContext());
+  Scratch.setDataLayout(F.getParent()->getDataLayout());
+  Scratch.setTargetTriple(F.getParent()->getTargetTriple());
+  for (auto &D : *F.getParent())
+    if (D.isDeclaration())
+      Scratch.getOrInsertFunction(D.getName(), D.getFunctionType(),
+                                  D.getAttributes());
+
   std::unordered_set<llvm::Function *> IntrinsicDecls;
 
   unsigned src_cost = get_approx_cost(&F);
@@ -702,6 +1120,8 @@ vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
   llvm::Triple Triple = llvm::Triple(F.getParent()->getTargetTriple());
   llvm::TargetLibraryInfoWrapperPass TLI(Triple);
 
+  // a cut of several roots pays for concatenating them, as a rewrite of it
+  // pays for being split into the roots again
   unsigned costBefore = get_machine_cost(&F);
 
   unsigned Width = I->getType()->getScalarSizeInBits();
@@ -710,238 +1130,327 @@ vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
     computeKnownBits(I, KnownI, DL);
 
   findInputs(F, I, DT);
-
-  vector<Sketch> Sketches;
-
-  // immediate constant synthesis
-  {
-    set<ReservedConst*> RCs;
-    auto RC = make_unique<ReservedConst>(type(I->getType()));
-    auto CI = make_unique<Copy>(*RC.get());
-    RCs.insert(RC.get());
-    Sketches.push_back(make_pair(CI.get(), std::move(RCs)));
-    exprs.emplace_back(std::move(CI));
-    exprs.emplace_back(std::move(RC));
-  }
-  // nops
-  {
-    for (auto &V : values) {
-      if (V->getType().getWidth() != I->getType()->getPrimitiveSizeInBits())
-        continue;
-      set<ReservedConst*> RCs;
-      auto VA = make_unique<Var>(V->V());
-      Sketches.push_back(make_pair(VA.get(), std::move(RCs)));
-      exprs.emplace_back(std::move(VA));
-    }
-  }
-
-  getSketches(&*I, Sketches);
-  debug() << "[enumerator] listing sketches\n";
-  for (auto &Sketch : Sketches) {
-    debug() << *Sketch.first << "\n";
-  }
-
-  unsigned CI = 0;
-
-  vector<Candidate> Fns;
-  auto FT = F.getFunctionType();
-  // sketches -> llvm functions
-
-  for (auto &Sketch : Sketches) {
-    bool HaveC = !Sketch.second.empty();
-    auto &G = Sketch.first;
+  features = TargetFeatures::get(F);
+  debug(mctx) << "[enumerator] target features: " << features.key() << "\n";
+  // Alive2 relaxes its semantics for nnan, ninf and nsz only, reassoc,
+  // arcp, contract and afn are carried over but not modeled, so rewrites
+  // that need them cannot be proven
+  fmf = common_fast_math_flags(F);
+  if (fmf.any())
+    debug(mctx) << "[enumerator] fast-math flags:" << fmf << "\n";
+
+  // the rewrite is emitted on its own in a copy of F and compared with it,
+  // its constants are already synthesized
+  auto Refines = [&](Inst *R) {
     llvm::ValueToValueMapTy VMap;
-
-    llvm::SmallVector<llvm::Type*, 8> Args;
-    for (auto A: FT->params()) {
-      Args.push_back(A);
-    }
-    for (auto &C : Sketch.second) {
-      Args.push_back(C->getType().toLLVM(F.getContext()));
-    }
-
-    auto _functionType =
-      llvm::FunctionType::get(FT->getReturnType(), Args, FT->isVarArg());
-
-    llvm::Function *Tgt =
-      llvm::Function::Create(_functionType, F.getLinkage(),
-                              F.getName(), F.getParent());
-
-
-    llvm::Function::arg_iterator TgtArgI = Tgt->arg_begin();
-
-    for (auto A = F.arg_begin(), E = F.arg_end(); A != E; ++A, ++TgtArgI) {
-      VMap[A] = TgtArgI;
-      TgtArgI->setName(A->getName());
-    }
-
-    unordered_map<const llvm::Argument*, ReservedConst*> ArgConst;
-    // sketches with constants, duplicate F
-    for (auto &C : Sketch.second) {
-      string arg_name = "_reservedc_" + std::to_string(CI);
-      TgtArgI->setName(arg_name);
-      C->setA(TgtArgI);
-      ArgConst[TgtArgI] = C;
-      ++CI;
-      ++TgtArgI;
-    }
-
-    llvm::SmallVector<llvm::ReturnInst*, 8> _returns;
-    llvm::CloneFunctionInto(Tgt, &F, VMap,
-      llvm::CloneFunctionChangeType::LocalChangesOnly, _returns);
-
-    llvm::Function *Src;
-    if (HaveC) {
-      llvm::ValueToValueMapTy _vs;
-      Src = llvm::CloneFunction(Tgt, _vs);
-    } else {
-      Src = &F;
-    }
-
-    llvm::Instruction *PrevI = llvm::cast<llvm::Instruction>(VMap[&*I]);
+    llvm::Function *Tgt = withConstants(F, Scratch, {}, VMap);
+    auto *PrevI = llvm::cast<llvm::Instruction>(VMap[&*I]);
     llvm::Value *V =
-        LLVMGen(PrevI, IntrinsicDecls).codeGen(G, VMap);
+      LLVMGen(PrevI, IntrinsicDecls, mctx, fmf).codeGen(R, VMap);
     V = llvm::IRBuilder<>(PrevI).CreateBitCast(V, PrevI->getType());
     PrevI->replaceAllUsesWith(V);
-
     eliminate_dead_code(*Tgt);
-    unsigned tgt_cost = get_approx_cost(Tgt);
-
-    ++CANDIDATES;
 
-    bool skip = false;
-    string err;
-    llvm::raw_string_ostream err_stream(err);
-    bool illformed = llvm::verifyFunction(*Tgt, &err_stream);
-    llvm::KnownBits KnownV(Width);
-
-
-    // TODO: add more pruning here
-    if (illformed) {
-      llvm::errs()<<"Error tgt found: "<<err<<"\n";
-      Tgt->dump();
-      skip = true;
-      goto push;
+    bool Good = false;
+    ++Stats.queried;
+    try {
+      AliveEngine AE(TLI, false, mctx);
+      Good = AE.compareFunctions(F, *Tgt);
+    } catch (AliveException E) {
+      debug(mctx) << E.msg << "\n";
     }
-
-    // check cost
-    if (tgt_cost >= src_cost) {
-      skip = true;
-      goto push;
+    Tgt->eraseFromParent();
+    return Good;
+  };
+
+  set<string> Tried;
+  bool CopiedC = false;
+  const unsigned FirstLimit =
+    mctx.max_inputs ? mctx.max_inputs : inputs.size();
+  unsigned Limit = FirstLimit;
+  // every tier widens the inputs on its own, the next tier starts over with
+  // the first inputs
+  unsigned T = 0;
+  const unsigned LastTier = std::min(mctx.max_tier, NumTiers - 1);
+  for (;;) {
+    if (Cancel && Cancel->isCancelled())
+      break;
+    Tier CurTier = static_cast<Tier>(T);
+    auto Deadline = start + std::chrono::milliseconds(
+      mctx.slice_to * 1000ull * TierBudget[T] / 100);
+    values.assign(inputs.begin(),
+                  inputs.begin() + std::min<size_t>(Limit, inputs.size()));
+    debug(mctx) << "[enumerator] tier " << T << ", enumerating over "
+                << values.size() << " of " << inputs.size() << " inputs\n";
+
+    vector<Sketch> Sketches;
+
+    // immediate constant synthesis, once the plain inputs failed
+    if (CurTier == Tier::Holes && !CopiedC) {
+      CopiedC = true;
+      set<ReservedConst*> RCs;
+      auto RC = make_unique<ReservedConst>(type(I->getType()));
+      auto CI = make_unique<Copy>(*RC.get());
+      RCs.insert(RC.get());
+      Sketches.push_back(make_pair(CI.get(), std::move(RCs)));
+      exprs.emplace_back(std::move(CI));
+      exprs.emplace_back(std::move(RC));
     }
-push:
-    if (skip) {
-      Tgt->eraseFromParent();
-      if (HaveC)
-        Src->eraseFromParent();
-    } else {
-      Fns.push_back(make_tuple(Tgt, Src, G, ArgConst, !Sketch.second.empty()));
+    // nops
+    if (CurTier == Tier::Trivial) {
+      for (auto &V : values) {
+        if (V->getType().getWidth() != I->getType()->getPrimitiveSizeInBits())
+          continue;
+        set<ReservedConst*> RCs;
+        auto VA = make_unique<Var>(V->V());
+        Sketches.push_back(make_pair(VA.get(), std::move(RCs)));
+        exprs.emplace_back(std::move(VA));
+      }
     }
-  }
-  std::stable_sort(Fns.begin(), Fns.end(), approx);
-  // llvm functions -> alive2 functions
-  auto iter = Fns.begin();
-
-  for (;iter != Fns.end();) {
-    auto &[Tgt, Src, G, ArgConst, HaveC] = *iter;
-    unsigned tgt_cost = get_approx_cost(Tgt);
-    debug() << "[enumerator] approx_cost(tgt) = " << tgt_cost
-            << ", approx_cost(src) = " << src_cost <<"\n";
-    debug() << *Tgt;
 
-    bool Good = false;
-    unordered_map<llvm::Argument*, llvm::Constant*> ConstantResults;
+    getSketches(&*I, Sketches, CurTier);
+    // skip the sketches of the previous rounds
+    erase_if(Sketches, [&Tried](Sketch &S) {
+      string str;
+      llvm::raw_string_ostream os(str);
+      S.first->print(os);
+      os.flush();
+      return !Tried.insert(std::move(str)).second;
+    });
+    debug(mctx) << "[enumerator] listing sketches\n";
+    for (auto &Sketch : Sketches) {
+      debug(mctx) << *Sketch.first << "\n";
+    }
 
-    try {
-      if (!HaveC) {
-        AliveEngine AE(TLI, false);
-        Good = AE.compareFunctions(*Src, *Tgt);
-      } else {
-        AliveEngine AE(TLI, true);
-        Good = AE.constantSynthesis(*Src, *Tgt, ConstantResults);
+    vector<Candidate> Fns;
+    // sketches are measured in a probe, a copy of F taking the constants of
+    // the sketch as extra arguments, made once per list of constant types.
+    // the sketch is emitted in front of the root of the probe, costed as if
+    // it replaced the root and erased again, so that a target of its own is
+    // only built for the candidates that reach the verifier. the probe is
+    // also the source of the queries with constants. the queries themselves
+    // still go through llvm2alive, an alive2 Transform owns its source and
+    // target, so a converted source cannot be shared between queries.
+    map<vector<llvm::Type*>,
+        pair<llvm::Function*, unique_ptr<llvm::ValueToValueMapTy>>> Probes;
+    auto ConstTypes = [&F](const Sketch &S) {
+      vector<llvm::Type*> ConstTys;
+      for (auto &C : S.second)
+        ConstTys.push_back(C->getType().toLLVM(F.getContext()));
+      return ConstTys;
+    };
+
+    // sketches -> candidates
+    for (auto &Sketch : Sketches) {
+      auto &G = Sketch.first;
+      auto &[Probe, PMap] = Probes[ConstTypes(Sketch)];
+      if (!Probe) {
+        PMap = make_unique<llvm::ValueToValueMapTy>();
+        Probe = withConstants(F, Scratch, ConstTypes(Sketch), *PMap);
       }
-    } catch (AliveException E) {
-      debug() << E.msg << "\n";
-      if (E.msg == "slow vcgen") {
+      auto ProbeArgI = Probe->arg_begin() + F.arg_size();
+      for (auto &C : Sketch.second)
+        C->setA(ProbeArgI++);
+
+      llvm::Instruction *PrevI = llvm::cast<llvm::Instruction>((*PMap)[&*I]);
+      llvm::Instruction *Before = PrevI->getPrevNode();
+      llvm::Value *V =
+          LLVMGen(PrevI, IntrinsicDecls, mctx, fmf).codeGen(G, *PMap);
+      V = llvm::IRBuilder<>(PrevI).CreateBitCast(V, PrevI->getType());
+      unsigned tgt_cost = costWith(*Probe, PrevI, V);
+
+      ++Stats.generated;
+
+      string err;
+      llvm::raw_string_ostream err_stream(err);
+      bool illformed = llvm::verifyFunction(*Probe, &err_stream);
+      if (illformed) {
+        mctx.dbg() << "Error tgt found: " << err << "\n" << *Probe;
+      }
+
+      // the code of the sketch, newest first
+      while (PrevI->getPrevNode() != Before)
+        PrevI->getPrevNode()->eraseFromParent();
+
+      // TODO: add more pruning here
+      if (illformed || tgt_cost >= src_cost) {
+        ++Stats.pruned;
         continue;
       }
+      Fns.emplace_back(&Sketch, tgt_cost);
     }
-    if (Good) {
-      GOOD ++;
-      Inst *R = G;
-      if (HaveC) {
-        for (auto &[A, C] : ConstantResults) {
-          //Consts[ArgConst[A]] = C;
-          ArgConst[A]->setC(C);
-          A->replaceAllUsesWith(C);
+    std::stable_sort(Fns.begin(), Fns.end(), approx);
+    // candidates -> llvm functions -> alive2 functions
+    auto iter = Fns.begin();
+
+    for (;iter != Fns.end(); ++iter) {
+      if (Cancel && Cancel->isCancelled()) {
+        debug(mctx) << "[enumerator] cancelled\n";
+        Stop = true;
+        break;
+      }
+
+      auto &[S, tgt_cost] = *iter;
+      Inst *G = S->first;
+      bool HaveC = !S->second.empty();
+      llvm::ValueToValueMapTy VMap;
+      llvm::Function *Tgt = withConstants(F, Scratch, ConstTypes(*S), VMap);
+
+      unordered_map<const llvm::Argument*, ReservedConst*> ArgConst;
+      llvm::Function::arg_iterator TgtArgI = Tgt->arg_begin() + F.arg_size();
+      for (auto &C : S->second) {
+        C->setA(TgtArgI);
+        ArgConst[TgtArgI] = C;
+        ++TgtArgI;
+      }
+      llvm::Function *Src = HaveC ? Probes[ConstTypes(*S)].first : &F;
+
+      llvm::Instruction *PrevI = llvm::cast<llvm::Instruction>(VMap[&*I]);
+      llvm::Value *V =
+          LLVMGen(PrevI, IntrinsicDecls, mctx, fmf).codeGen(G, VMap);
+      V = llvm::IRBuilder<>(PrevI).CreateBitCast(V, PrevI->getType());
+      PrevI->replaceAllUsesWith(V);
+      eliminate_dead_code(*Tgt);
+
+      debug(mctx) << "[enumerator] approx_cost(tgt) = " << tgt_cost
+              << ", approx_cost(src) = " << src_cost <<"\n";
+      debug(mctx) << *Tgt;
+
+      bool Good = false;
+      unordered_map<llvm::Argument*, llvm::Constant*> ConstantResults;
+
+      // the holes of a data movement are traced by evaluation, and the
+      // rewrite is checked once with them
+      unordered_map<ReservedConst*, llvm::Constant*> Holes;
+      if (HaveC && solveLaneHoles(F, &*I, G, Holes)) {
+        debug(mctx) << "[enumerator] lanes traced, checking the holes\n";
+        for (auto &[RC, C] : Holes)
+          RC->setC(C);
+        if (Refines(G)) {
+          for (auto &[A, RC] : ArgConst)
+            ConstantResults[const_cast<llvm::Argument*>(A)] = RC->getC();
+          Good = true;
         }
+        for (auto &[RC, C] : Holes)
+          RC->setC(nullptr);
       }
 
-      // rewrite fksv calls to shufflevector
-      for (auto &BB : *Tgt) {
-        for (auto &I : make_early_inc_range(BB)) {
-          if (!isa<llvm::CallInst>(&I))
-            continue;
-          auto CI = llvm::cast<llvm::CallInst>(&I);
+      if (!Good) {
+        ++Stats.queried;
+        try {
+          if (!HaveC) {
+            AliveEngine AE(TLI, false, mctx);
+            Good = AE.compareFunctions(*Src, *Tgt);
+          } else {
+            AliveEngine AE(TLI, true, mctx);
+            Good = AE.constantSynthesis(*Src, *Tgt, ConstantResults);
+          }
+        } catch (AliveException E) {
+          debug(mctx) << E.msg << "\n";
+        }
+      }
+      if (Good) {
+        ++Stats.proven;
+        Inst *R = G;
+        if (HaveC) {
+          for (auto &[A, C] : ConstantResults) {
+            //Consts[ArgConst[A]] = C;
+            ArgConst[A]->setC(C);
+            A->replaceAllUsesWith(C);
+          }
+        }
 
-          auto callee = CI->getCalledFunction();
-          if(!callee)
-            continue;
-          if (!callee->getName().starts_with("__fksv"))
-            continue;
+        // rewrite fksv calls to shufflevector
+        for (auto &BB : *Tgt) {
+          for (auto &I : make_early_inc_range(BB)) {
+            if (!isa<llvm::CallInst>(&I))
+              continue;
+            auto CI = llvm::cast<llvm::CallInst>(&I);
+
+            auto callee = CI->getCalledFunction();
+            if(!callee)
+              continue;
+            if (!callee->getName().starts_with("__fksv"))
+              continue;
 
-          auto shuf = new llvm::ShuffleVectorInst(CI->getArgOperand(0),
-                                                  CI->getArgOperand(1),
-                                                  CI->getArgOperand(2), "", CI);
-          CI->replaceAllUsesWith(shuf);
-          CI->eraseFromParent();
+            auto shuf = new llvm::ShuffleVectorInst(CI->getArgOperand(0),
+                                                    CI->getArgOperand(1),
+                                                    CI->getArgOperand(2), "", CI);
+            CI->replaceAllUsesWith(shuf);
+            CI->eraseFromParent();
+          }
         }
-      }
 
-      unsigned costAfter = get_machine_cost(Tgt);
+        unsigned costAfter = get_machine_cost(Tgt);
 
-      debug() << "[enumerator] optimized ir (uops=" << costAfter <<")"
-              << ", original cost (uops=" << costBefore << "), \n"
-              << *Tgt << "\n";
+        debug(mctx) << "[enumerator] optimized ir (uops=" << costAfter <<")"
+                << ", original cost (uops=" << costBefore << "), \n"
+                << *Tgt << "\n";
 
-      if (!costAfter || !costBefore) {
-        debug() << "[enumerator] cost is zero, skip\n";
-      } else if (config::ignore_machine_cost || costAfter < costBefore) {
-        debug () << "[enumerator] successfully synthesized rhs\n";
-        ret.emplace_back(R, costAfter, costBefore);
-      } else {
-        debug() << "[enumerator] successfully synthesized rhs, "
-                << "however, rhs is more expensive than lhs\n";
+        if (!costAfter || !costBefore) {
+          debug(mctx) << "[enumerator] cost is zero, skip\n";
+        } else if (mctx.ignore_machine_cost || costAfter < costBefore) {
+          debug(mctx) << "[enumerator] successfully synthesized rhs\n";
+          strengthenFlags(R, Refines);
+          Found = true;
+          if (!OnRewrite(Rewrite{R, costAfter, costBefore}, Stats))
+            Stop = true;
+        } else {
+          debug(mctx) << "[enumerator] successfully synthesized rhs, "
+                  << "however, rhs is more expensive than lhs\n";
+        }
       }
-    }
 
-    if (HaveC)
-      Src->eraseFromParent();
-    Tgt->eraseFromParent();
+      Tgt->eraseFromParent();
 
-    iter = Fns.erase(iter);
+      if (Stop) {
+        debug(mctx) << "[enumerator] search stopped by the caller\n";
+        break;
+      }
+      if (std::chrono::steady_clock::now() > Deadline) {
+        debug(mctx) << "[enumerator] timeout for tier " << T << ", skipping\n";
+        break;
+      }
+    }
+
+    for (auto &[_, P] : Probes)
+      P.first->eraseFromParent();
 
-    unsigned Duration = ( std::clock() - start ) / CLOCKS_PER_SEC;
-    if ((config::return_first_solution && Good)) {
-      debug() << "[enumerator] returning first solution\n";
+    if (Found || Stop)
       break;
+    // widen the inputs while the budget of the tier allows, then escalate
+    if (std::chrono::steady_clock::now() <= Deadline &&
+        values.size() < inputs.size()) {
+      Limit *= 2;
+      continue;
     }
-    if (Duration > config::slice_to) {
-      debug() << "[enumerator] timeout for candidate, skipping\n";
+    if (T == LastTier)
       break;
-    }
+    ++T;
+    Limit = FirstLimit;
   }
 
-  for (;iter != Fns.end(); ++iter) {
-    auto &[Tgt, Src, _, __, HaveC] = *iter;
-    if (HaveC)
-      Src->eraseFromParent();
-    Tgt->eraseFromParent();
-  }
+  debug(mctx) << "[enumerator] #Candidates = "<< Stats.generated
+          << ", #Pruned = " << Stats.pruned
+          << ", #Queried = " << Stats.queried
+          << ", #Good = " << Stats.proven << "\n";
+  auto [Hits, Misses] = SketchCache::get().stats();
+  debug(mctx) << "[enumerator] sketch templates: " << Hits << " hits, "
+              << Misses << " misses\n";
+
+  return Stats;
+}
 
-  debug() << "[enumerator] #Candidates = "<< CANDIDATES
-          << ", #Pruned = " << PRUNED
-          << ", #Good = " << GOOD << "\n";
+vector<Rewrite> Enumerator::solve(llvm::Function &F, llvm::Instruction *I) {
+  vector<Rewrite> ret;
+  solve(F, I, [this, &ret](const Rewrite &R, const SolveStats &) {
+    ret.push_back(R);
+    if (mctx.return_first_solution) {
+      debug(mctx) << "[enumerator] returning first solution\n";
+      return false;
+    }
+    return true;
+  });
 
   std::stable_sort(ret.begin(), ret.end(),
     [](const Rewrite &a, const Rewrite &b) {
@@ -949,11 +1458,10 @@ push:
     });
 
   for (auto &R : ret) {
-    debug() << "[enumerator] rewrite: " << *R.I
+    debug(mctx) << "[enumerator] rewrite: " << *R.I
             << ", cost="<<  R.CostAfter << "\n";
   }
 
-  removeUnusedDecls(IntrinsicDecls);
   return ret;
 }
 
@@ -58,6 +58,46 @@ void UnaryOp::print(raw_ostream &os) const {
   case fround:     str = "fround";     break;
   case froundeven: str = "froundeven"; break;
   case ftrunc:     str = "ftrunc";     break;
+  case abs:        str = "abs";        break;
+  }
+  os << "(" << str << " " << workty << " ";
+  v->print(os);
+  os << ")";
+}
+
+void TernaryOp::print(raw_ostream &os) const {
+  const char *str = nullptr;
+  switch (op) {
+  case fshl: str = "fshl"; break;
+  case fshr: str = "fshr"; break;
+  case fma:     str = "fma";     break;
+  case fmuladd: str = "fmuladd"; break;
+  }
+  os << "(" << str << " " << workty << " ";
+  a->print(os);
+  os << " ";
+  b->print(os);
+  os << " ";
+  c->print(os);
+  os << ")";
+}
+
+void Reduction::print(raw_ostream &os) const {
+  const char *str = nullptr;
+  switch (op) {
+  case add:  str = "reduce_add";  break;
+  case mul:  str = "reduce_mul";  break;
+  case band: str = "reduce_and";  break;
+  case bor:  str = "reduce_or";   break;
+  case bxor: str = "reduce_xor";  break;
+  case smax: str = "reduce_smax"; break;
+  case smin: str = "reduce_smin"; break;
+  case umax: str = "reduce_umax"; break;
+  case umin: str = "reduce_umin"; break;
+  case fadd: str = "reduce_fadd"; break;
+  case fmul: str = "reduce_fmul"; break;
+  case fmax: str = "reduce_fmax"; break;
+  case fmin: str = "reduce_fmin"; break;
   }
   os << "(" << str << " " << workty << " ";
   v->print(os);
@@ -91,9 +131,24 @@ void BinaryOp::print(raw_ostream &os) const {
   case fmaximum:   str = "fmaximum"; break;
   case fminimum:   str = "fminimum"; break;
   case copysign:   str = "copysign"; break;
+  case uadd_sat:   str = "uadd_sat"; break;
+  case sadd_sat:   str = "sadd_sat"; break;
+  case usub_sat:   str = "usub_sat"; break;
+  case ssub_sat:   str = "ssub_sat"; break;
+  case rotl:       str = "rotl";     break;
+  case rotr:       str = "rotr";     break;
   // case frem:       str = "frem"; break;
   }
-  os << "(" << str << " " << workty << " ";
+  os << "(" << str;
+  if (flags & nuw)
+    os << " nuw";
+  if (flags & nsw)
+    os << " nsw";
+  if (flags & exact)
+    os << " exact";
+  if (flags & disjoint)
+    os << " disjoint";
+  os << " " << workty << " ";
   lhs->print(os);
   os << " ";
   rhs->print(os);
@@ -160,6 +215,15 @@ void SIMDBinOpInst::print(raw_ostream &os) const {
   os << ")";
 }
 
+void SIMDTerOpInst::print(raw_ostream &os) const {
+  os << "(" << IR::X86IntrinTerOp::getOpName(op) << " ";
+  a->print(os);
+  os << " ";
+  b->print(os);
+  os << " ";
+  c->print(os);
+  os << ")";
+}
 
 void FakeShuffleInst::print(raw_ostream &os) const {
   if (rhs)
@@ -296,7 +360,7 @@ void Select::print(raw_ostream &os) const {
 }
 
 
-vector<type> getUnaryOpWorkTypes(type ty, UnaryOp::Op op) {
+WorkTypes getUnaryOpWorkTypes(type ty, UnaryOp::Op op) {
   if (UnaryOp::isFloatingPoint(op)) {
     if (ty.isFP()) {
       return { ty };
@@ -307,11 +371,11 @@ vector<type> getUnaryOpWorkTypes(type ty, UnaryOp::Op op) {
     unsigned width = ty.getWidth();
     if (width % 16)
       return {};
-    vector<unsigned> bits = { 64, 32, 16 };
-    vector<type> types;
-    for (unsigned i = 0 ; i < bits.size() ; ++ i) {
-      if (width % bits[i] == 0 && width >= bits[i]) {
-        types.push_back(type::IntegerVectorizable(width/bits[i], bits[i]));
+    static constexpr unsigned bits[] = { 64, 32, 16 };
+    WorkTypes types;
+    for (unsigned b : bits) {
+      if (width % b == 0 && width >= b) {
+        types.push_back(type::IntegerVectorizable(width/b, b));
       }
     }
     return types;
@@ -320,7 +384,7 @@ vector<type> getUnaryOpWorkTypes(type ty, UnaryOp::Op op) {
   }
 }
 
-vector<type> getBinaryOpWorkTypes(type ty, BinaryOp::Op op) {
+WorkTypes getBinaryOpWorkTypes(type ty, BinaryOp::Op op) {
   if (BinaryOp::isFloatingPoint(op)) {
     if (ty.isFP()) {
       return { ty };
@@ -329,12 +393,27 @@ vector<type> getBinaryOpWorkTypes(type ty, BinaryOp::Op op) {
     }
   } else if (BinaryOp::isLogical(op)) {
     return { ty.getAsIntTy() };
+  } else if (BinaryOp::isSaturating(op)) {
+    // x86 only saturates bytes and words
+    WorkTypes types;
+    for (auto t : getIntegerVectorTypes(ty))
+      if (t.getBits() <= 16)
+        types.push_back(t);
+    return types;
   } else {
     return getIntegerVectorTypes(ty);
   }
 }
 
-vector<type> getShuffleWorkTypes(type ty) {
+WorkTypes getTernaryOpWorkTypes(type ty, TernaryOp::Op op) {
+  if (TernaryOp::isFloatingPoint(op))
+    return ty.isFP() ? WorkTypes{ ty } : WorkTypes{};
+  if (ty.isFP())
+    return {};
+  return getIntegerVectorTypes(ty);
+}
+
+WorkTypes getShuffleWorkTypes(type ty) {
   if (ty.isFP()) {
     return { ty };
   } else {
@@ -342,12 +421,11 @@ vector<type> getShuffleWorkTypes(type ty) {
   }
 }
 
-vector<type> getConversionOpWorkTypes(type to, type from) {
-  vector<type> tys = getIntegerVectorTypes(to);
-  return tys;
+WorkTypes getConversionOpWorkTypes(type to, type from) {
+  return getIntegerVectorTypes(to);
 }
 
-vector<type> getInsertElementWorkTypes(type ty) {
+WorkTypes getInsertElementWorkTypes(type ty) {
   if (ty.isFP()) {
     if (ty.getLane() != 1) {
       return { ty.getAsScalar() };
@@ -366,12 +444,12 @@ vector<type> getInsertElementWorkTypes(type ty) {
     }
   }
 
-  vector<unsigned> bits = {64, 32, 16, 8};
-  vector<type> types;
+  static constexpr unsigned bits[] = {64, 32, 16, 8};
+  WorkTypes types;
 
-  for (unsigned i = 0 ; i < bits.size() ; ++ i) {
-    if (width % bits[i] == 0 && width > bits[i]) {
-      types.push_back(type::IntegerVectorizable(width/bits[i], bits[i]));
+  for (unsigned b : bits) {
+    if (width % b == 0 && width > b) {
+      types.push_back(type::IntegerVectorizable(width/b, b));
     }
   }
   return types;
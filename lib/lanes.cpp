@@ -0,0 +1,206 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "lanes.h"
+
+#include "llvm/Analysis/ConstantFolding.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/DataLayout.h"
+#include "llvm/IR/DerivedTypes.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Module.h"
+
+#include <optional>
+#include <vector>
+
+using namespace llvm;
+using namespace std;
+
+namespace minotaur {
+
+namespace {
+
+// the value of every instruction of F when its arguments are tagged with
+// consecutive integers of the element width of the sketch
+class LaneEvaluator {
+  const DataLayout &DL;
+  unsigned Bits;
+  IntegerType *EltTy;
+  unordered_map<llvm::Value*, Constant*> Vals;
+
+  // the tags of the lanes of Ty, viewed as Bits wide elements
+  Constant *tags(Type *Ty, uint64_t &Next) {
+    if (!Ty->isIntOrIntVectorTy() && !Ty->isFPOrFPVectorTy())
+      return nullptr;
+    uint64_t Width = DL.getTypeSizeInBits(Ty);
+    if (Width % Bits)
+      return nullptr;
+    vector<Constant*> Lanes;
+    for (uint64_t i = 0; i < Width / Bits; ++i)
+      Lanes.push_back(ConstantInt::get(EltTy, Next++));
+    return ConstantFoldCastOperand(Instruction::BitCast,
+                                   ConstantVector::get(Lanes), Ty, DL);
+  }
+
+public:
+  LaneEvaluator(Function &F, unsigned Bits)
+    : DL(F.getParent()->getDataLayout()), Bits(Bits),
+      EltTy(IntegerType::get(F.getContext(), Bits)) {}
+
+  // false if there are more lanes than tags of the element width
+  bool run(Function &F) {
+    uint64_t Next = 1;
+    for (auto &A : F.args())
+      if (auto *C = tags(A.getType(), Next))
+        Vals[&A] = C;
+    if (Bits < 64 && Next > (1ull << Bits))
+      return false;
+
+    // instructions that do not only move lanes fold to other values, or do
+    // not fold at all and stay unknown
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (I.isTerminator() || isa<PHINode>(&I))
+          continue;
+        SmallVector<Constant*, 4> Ops;
+        for (auto &Op : I.operands()) {
+          if (auto *C = dyn_cast<Constant>(Op))
+            Ops.push_back(C);
+          else if (auto it = Vals.find(Op); it != Vals.end())
+            Ops.push_back(it->second);
+          else
+            break;
+        }
+        if (Ops.size() != I.getNumOperands())
+          continue;
+        if (auto *C = ConstantFoldInstOperands(&I, Ops, DL))
+          Vals[&I] = C;
+      }
+    }
+    return true;
+  }
+
+  // the tags of V as Bits wide lanes, a null lane is poison
+  optional<vector<Constant*>> lanes(llvm::Value *V) {
+    auto it = Vals.find(V);
+    if (it == Vals.end())
+      return nullopt;
+    uint64_t Width = DL.getTypeSizeInBits(V->getType());
+    if (Width % Bits)
+      return nullopt;
+    unsigned N = Width / Bits;
+    auto *C = ConstantFoldCastOperand(Instruction::BitCast, it->second,
+                                      FixedVectorType::get(EltTy, N), DL);
+    if (!C)
+      return nullopt;
+    vector<Constant*> Out;
+    for (unsigned i = 0; i < N; ++i) {
+      Constant *E = C->getAggregateElement(i);
+      if (!E)
+        return nullopt;
+      Out.push_back(isa<UndefValue>(E) ? nullptr : E);
+    }
+    return Out;
+  }
+};
+
+// the position of Tag in Lanes
+optional<unsigned> lane(const vector<Constant*> &Lanes, Constant *Tag) {
+  for (unsigned i = 0; i < Lanes.size(); ++i)
+    if (Lanes[i] == Tag)
+      return i;
+  return nullopt;
+}
+
+llvm::Value *operand(minotaur::Value *V) {
+  if (auto *Arg = dynamic_cast<Var*>(V))
+    return Arg->V();
+  return nullptr;
+}
+
+}
+
+bool solveLaneHoles(Function &F, Instruction *Root, Inst *Sketch,
+                    unordered_map<ReservedConst*, Constant*> &Holes) {
+  LLVMContext &C = F.getContext();
+
+  if (auto *FS = dynamic_cast<FakeShuffleInst*>(Sketch)) {
+    llvm::Value *L = operand(FS->L());
+    llvm::Value *R = FS->R() ? operand(FS->R()) : nullptr;
+    if (!L || (FS->R() && !R))
+      return false;
+
+    LaneEvaluator E(F, FS->getElementBits());
+    if (!E.run(F))
+      return false;
+    auto Out = E.lanes(Root), LL = E.lanes(L);
+    if (!Out || !LL)
+      return false;
+    optional<vector<Constant*>> RL;
+    if (R && !(RL = E.lanes(R)))
+      return false;
+
+    auto *MaskTy = cast<FixedVectorType>(FS->M()->getType().toLLVM(C));
+    if (MaskTy->getNumElements() != Out->size())
+      return false;
+    Type *IdxTy = MaskTy->getElementType();
+    vector<Constant*> Mask;
+    for (Constant *Tag : *Out) {
+      if (!Tag) {
+        Mask.push_back(PoisonValue::get(IdxTy));
+      } else if (auto i = lane(*LL, Tag)) {
+        Mask.push_back(ConstantInt::get(IdxTy, *i));
+      } else if (RL && (i = lane(*RL, Tag))) {
+        Mask.push_back(ConstantInt::get(IdxTy, LL->size() + *i));
+      } else {
+        return false;
+      }
+    }
+    Holes[FS->M()] = ConstantVector::get(Mask);
+    return true;
+  }
+
+  if (auto *EE = dynamic_cast<ExtractElement*>(Sketch)) {
+    llvm::Value *V = operand(EE->V());
+    if (!V)
+      return false;
+
+    LaneEvaluator E(F, EE->getType().getWidth());
+    if (!E.run(F))
+      return false;
+    auto Out = E.lanes(Root), VL = E.lanes(V);
+    if (!Out || !VL || Out->size() != 1 || !(*Out)[0])
+      return false;
+    auto i = lane(*VL, (*Out)[0]);
+    if (!i)
+      return false;
+    Holes[EE->Idx()] = ConstantInt::get(EE->Idx()->getType().toLLVM(C), *i);
+    return true;
+  }
+
+  if (auto *IE = dynamic_cast<InsertElement*>(Sketch)) {
+    llvm::Value *V = operand(IE->V()), *Elt = operand(IE->Elt());
+    if (!V || !Elt)
+      return false;
+
+    LaneEvaluator E(F, IE->Elt()->getType().getWidth());
+    if (!E.run(F))
+      return false;
+    auto Out = E.lanes(Root), VL = E.lanes(V), EL = E.lanes(Elt);
+    if (!Out || !VL || !EL || EL->size() != 1 || !(*EL)[0] ||
+        Out->size() != VL->size())
+      return false;
+    // every lane but the inserted one is kept
+    auto i = lane(*Out, (*EL)[0]);
+    if (!i)
+      return false;
+    for (unsigned j = 0; j < Out->size(); ++j)
+      if (j != *i && (*Out)[j] && (*Out)[j] != (*VL)[j])
+        return false;
+    Holes[IE->Idx()] = ConstantInt::get(IE->Idx()->getType().toLLVM(C), *i);
+    return true;
+  }
+
+  return false;
+}
+
+} // namespace minotaur
@@ -4,6 +4,7 @@
 #include "expr.h"
 #include "config.h"
 #include "lexer.h"
+#include "serialize.h"
 
 #include "iostream"
 #include "ir/instr.h"
@@ -25,11 +26,14 @@ using namespace std;
 using namespace minotaur;
 
 struct debug {
+  const minotaur::MinotaurContext &mctx;
+  debug(const minotaur::MinotaurContext &mctx) : mctx(mctx) {}
+
   template<class T>
   debug &operator<<(const T &s)
   {
-    if (minotaur::config::debug_parser)
-      minotaur::config::dbg()<<s;
+    if (mctx.debug_parser)
+      mctx.dbg()<<s;
     return *this;
   }
 };
@@ -37,87 +41,83 @@ struct debug {
 
 namespace parse {
 
-static void error(string &&s) {
-  throw ParseException(std::move(s), yylineno);
+void tokenizer_t::error(string &&s) const {
+  throw ParseException(std::move(s), lexer.yylineno);
 }
 
-struct tokenizer_t {
-  token last;
-  // true if token last was 'unget' and should be returned next
-  bool returned = false;
+void tokenizer_t::init(string_view buf) {
+  lexer.yylex_init(buf);
+  returned = false;
+}
 
-  token operator*() {
-    if (returned) {
-      returned = false;
-      return last;
-    }
-    return get_new_token();
+token tokenizer_t::operator*() {
+  if (returned) {
+    returned = false;
+    return last;
   }
+  return get_new_token();
+}
 
-  token peek() {
-    if (returned)
-      return last;
-    returned = true;
-    return last = get_new_token();
-  }
+token tokenizer_t::peek() {
+  if (returned)
+    return last;
+  returned = true;
+  return last = get_new_token();
+}
 
-  bool consumeIf(token expected) {
-    auto token = peek();
-    if (token == expected) {
-      returned = false;
-      return true;
-    }
-    return false;
+bool tokenizer_t::consumeIf(token expected) {
+  auto token = peek();
+  if (token == expected) {
+    returned = false;
+    return true;
   }
+  return false;
+}
 
-  void ensure(token expected) {
-    auto t = **this;
-    if (t != expected)
-      error(string("expected token: ") + token_name[expected] + ", got: " +
-            token_name[t]);
-  }
+void tokenizer_t::ensure(token expected) {
+  auto t = **this;
+  if (t != expected)
+    error(string("expected token: ") + token_name[expected] + ", got: " +
+          token_name[t]);
+}
 
-  void unget(token t) {
-    assert(returned == false);
-    returned = true;
-    last = t;
-  }
+void tokenizer_t::unget(token t) {
+  assert(returned == false);
+  returned = true;
+  last = t;
+}
 
-  bool empty() {
-    return peek() == END;
-  }
+bool tokenizer_t::empty() {
+  return peek() == END;
+}
 
-  bool isType() {
-    return isScalarType() || isVectorType();
-  }
+bool tokenizer_t::isType() {
+  return isScalarType() || isVectorType();
+}
 
-  bool isScalarType() {
-    return peek() == INT_TYPE ||
-           peek() == FLOAT || peek() == DOUBLE ||
-           peek() == HALF || peek() == FP128;
-  }
+bool tokenizer_t::isScalarType() {
+  return peek() == INT_TYPE ||
+         peek() == FLOAT || peek() == DOUBLE ||
+         peek() == HALF || peek() == FP128;
+}
 
-  bool isVectorType() {
-    return peek() == VECTOR_TYPE_PREFIX;
-  }
+bool tokenizer_t::isVectorType() {
+  return peek() == VECTOR_TYPE_PREFIX;
+}
 
-private:
-  token get_new_token() const {
-    try {
-      auto t = yylex();
+token tokenizer_t::get_new_token() {
+  try {
+    auto t = lexer.yylex();
 #if YYDEBUG
-      cout << "token: " << token_name[t] << '\n';
+    cout << "token: " << token_name[t] << '\n';
 #endif
-      return t;
-    } catch (LexException &e) {
-      throw ParseException(std::move(e.str), e.lineno);
-    }
+    return t;
+  } catch (LexException &e) {
+    throw ParseException(std::move(e.str), e.lineno);
   }
-};
-
-static tokenizer_t tokenizer;
+}
 
-static type parse_scalar_type() {
+type Parser::parse_scalar_type() {
   switch (tokenizer.peek()) {
   case FLOAT:
     tokenizer.ensure(FLOAT);
@@ -133,60 +133,58 @@ static type parse_scalar_type() {
     return type::FP128();
   case INT_TYPE:
     tokenizer.ensure(INT_TYPE);
-    return type::Scalar(yylval.num, false);
+    return type::Scalar(tokenizer.lexer.yylval.num, false);
   default:
-    UNREACHABLE();
+    tokenizer.error("expected a scalar type");
   }
 }
 
-static type parse_vector_type() {
+type Parser::parse_vector_type() {
   tokenizer.ensure(VECTOR_TYPE_PREFIX);
-  unsigned lane = yylval.num;
+  unsigned lane = tokenizer.lexer.yylval.num;
   auto type = parse_scalar_type();
   tokenizer.ensure(CSGT);
   return type.getAsVector(lane);
 }
 
-static type parse_type() {
+type Parser::parse_type() {
   if (tokenizer.isScalarType())
     return parse_scalar_type();
   else if (tokenizer.isVectorType())
     return parse_vector_type();
-  UNREACHABLE();
+  tokenizer.error("expected a type");
 }
 
 Var *Parser::parse_var() {
   type ty = parse_type();
   tokenizer.ensure(REGISTER);
-  string id(yylval.str);
+  string id(tokenizer.lexer.yylval.str);
   id.erase(id.begin());
   tokenizer.ensure(RPAREN);
 
   llvm::Value *LV = F.getValueSymbolTable()->lookup(id);
-  if (!LV) {
-    debug()<<"[parser] value not found: "<<id<<"\n";
-    llvm::report_fatal_error("[parser] terminating");
-  }
+  if (!LV)
+    tokenizer.error("value not found: " + id);
   auto V = make_unique<Var>(LV);
   Var *T = V.get();
   exprs.emplace_back(std::move(V));
   return T;
 }
 
-unsigned parse_number() {
+unsigned Parser::parse_number() {
   tokenizer.ensure(BITS);
-  return yylval.num;;
+  return tokenizer.lexer.yylval.num;
 }
 
 ReservedConst* Parser::parse_const() {
   type t = parse_type();
 
   tokenizer.ensure(LITERAL);
-  string lt(yylval.str);
+  string lt(tokenizer.lexer.yylval.str);
   lt.pop_back();
   lt.erase(lt.begin());
 
-  debug() << "literal: " << lt << '\n';
+  debug(mctx) << "literal: " << lt << '\n';
 
   tokenizer.ensure(RPAREN);
   llvm::SMDiagnostic diag;
@@ -242,6 +240,8 @@ UnaryOp* Parser::parse_unary(token op_token) {
     op = UnaryOp::froundeven; break;
   case FTRUNC:
     op = UnaryOp::ftrunc; break;
+  case ABS:
+    op = UnaryOp::abs; break;
   // TODO: add
   default:
     UNREACHABLE();
@@ -256,6 +256,74 @@ UnaryOp* Parser::parse_unary(token op_token) {
   return T;
 }
 
+TernaryOp *Parser::parse_ternary(token op_token) {
+  TernaryOp::Op op;
+  switch (op_token) {
+  case FSHL:
+    op = TernaryOp::fshl; break;
+  case FSHR:
+    op = TernaryOp::fshr; break;
+  case FMA:
+    op = TernaryOp::fma; break;
+  case FMULADD:
+    op = TernaryOp::fmuladd; break;
+  default:
+    UNREACHABLE();
+  }
+  type workty = parse_type();
+  auto a = parse_expr();
+  auto b = parse_expr();
+  auto c = parse_expr();
+
+  tokenizer.ensure(RPAREN);
+  auto TI = make_unique<TernaryOp>(op, *a, *b, *c, workty);
+  TernaryOp *T = TI.get();
+  exprs.emplace_back(std::move(TI));
+  return T;
+}
+
+Reduction *Parser::parse_reduction(token op_token) {
+  Reduction::Op op;
+  switch (op_token) {
+  case REDUCE_ADD:
+    op = Reduction::add; break;
+  case REDUCE_MUL:
+    op = Reduction::mul; break;
+  case REDUCE_AND:
+    op = Reduction::band; break;
+  case REDUCE_OR:
+    op = Reduction::bor; break;
+  case REDUCE_XOR:
+    op = Reduction::bxor; break;
+  case REDUCE_SMAX:
+    op = Reduction::smax; break;
+  case REDUCE_SMIN:
+    op = Reduction::smin; break;
+  case REDUCE_UMAX:
+    op = Reduction::umax; break;
+  case REDUCE_UMIN:
+    op = Reduction::umin; break;
+  case REDUCE_FADD:
+    op = Reduction::fadd; break;
+  case REDUCE_FMUL:
+    op = Reduction::fmul; break;
+  case REDUCE_FMAX:
+    op = Reduction::fmax; break;
+  case REDUCE_FMIN:
+    op = Reduction::fmin; break;
+  default:
+    UNREACHABLE();
+  }
+  type workty = parse_type();
+  auto a = parse_expr();
+
+  tokenizer.ensure(RPAREN);
+  auto RI = make_unique<Reduction>(op, *a, workty);
+  Reduction *T = RI.get();
+  exprs.emplace_back(std::move(RI));
+  return T;
+}
+
 BinaryOp *Parser::parse_binary(token op_token) {
   BinaryOp::Op op;
   switch (op_token) {
@@ -307,16 +375,44 @@ BinaryOp *Parser::parse_binary(token op_token) {
     op = BinaryOp::fminimum; break;
   case COPYSIGN:
     op = BinaryOp::copysign; break;
+  case UADD_SAT:
+    op = BinaryOp::uadd_sat; break;
+  case SADD_SAT:
+    op = BinaryOp::sadd_sat; break;
+  case USUB_SAT:
+    op = BinaryOp::usub_sat; break;
+  case SSUB_SAT:
+    op = BinaryOp::ssub_sat; break;
+  case ROTL:
+    op = BinaryOp::rotl; break;
+  case ROTR:
+    op = BinaryOp::rotr; break;
   // TODO: add
   default:
     UNREACHABLE();
   }
+  unsigned flags = 0;
+  for (;;) {
+    if (tokenizer.consumeIf(NUW))
+      flags |= BinaryOp::nuw;
+    else if (tokenizer.consumeIf(NSW))
+      flags |= BinaryOp::nsw;
+    else if (tokenizer.consumeIf(EXACT))
+      flags |= BinaryOp::exact;
+    else if (tokenizer.consumeIf(DISJOINT))
+      flags |= BinaryOp::disjoint;
+    else
+      break;
+  }
+  if (flags & ~BinaryOp::allowedFlags(op))
+    tokenizer.error("flags not allowed on the operation");
   auto workty = parse_type();
   auto a = parse_expr();
   auto b = parse_expr();
 
   tokenizer.ensure(RPAREN);
   auto BI = make_unique<BinaryOp>(op, *a, *b, workty);
+  BI->setFlags(flags);
   BinaryOp *T = BI.get();
   exprs.emplace_back(std::move(BI));
   return T;
@@ -417,6 +513,7 @@ FakeShuffleInst *Parser::parse_shuffle(token op_token) {
   tokenizer.ensure(LPAREN);
   tokenizer.ensure(CONST);
   auto mask = parse_const();
+  tokenizer.ensure(RPAREN);
   auto SI = make_unique<FakeShuffleInst>(*lhs, rhs, *mask, workty);
   FakeShuffleInst *T = SI.get();
   exprs.emplace_back(std::move(SI));
@@ -474,6 +571,32 @@ FPConversion *Parser::parse_fpconv(token op_token) {
   return T;
 }
 
+// x86 intrinsics share a token, the name tells binary from ternary ones
+static bool isTernaryX86(string_view ops) {
+  #define PROCESS(NAME,A,B,C,D,E,F,G,H) if (ops == #NAME) return true;
+  #include "ir/intrinsics_terop.h"
+  #undef PROCESS
+  return false;
+}
+
+SIMDTerOpInst *Parser::parse_x86_ter(string_view ops) {
+  IR::X86IntrinTerOp::Op op;
+  #define PROCESS(NAME,A,B,C,D,E,F,G,H) \
+    if (ops == #NAME) op = IR::X86IntrinTerOp::NAME;
+  #include "ir/intrinsics_terop.h"
+  #undef PROCESS
+
+  auto a = parse_expr();
+  auto b = parse_expr();
+  auto c = parse_expr();
+
+  tokenizer.ensure(RPAREN);
+  auto CI = make_unique<SIMDTerOpInst>(op, *a, *b, *c);
+  SIMDTerOpInst *T = CI.get();
+  exprs.emplace_back(std::move(CI));
+  return T;
+}
+
 SIMDBinOpInst *Parser::parse_x86(string_view ops) {
   IR::X86IntrinBinOp::Op op;
   #define PROCESS(NAME,A,B,C,D,E,F) if (ops == #NAME) op = IR::X86IntrinBinOp::NAME;
@@ -551,7 +674,22 @@ Value* Parser::parse_expr() {
   case FROUND:
   case FROUNDEVEN:
   case FTRUNC:
+  case ABS:
     return parse_unary(t);
+  case REDUCE_ADD:
+  case REDUCE_MUL:
+  case REDUCE_AND:
+  case REDUCE_OR:
+  case REDUCE_XOR:
+  case REDUCE_SMAX:
+  case REDUCE_SMIN:
+  case REDUCE_UMAX:
+  case REDUCE_UMIN:
+  case REDUCE_FADD:
+  case REDUCE_FMUL:
+  case REDUCE_FMAX:
+  case REDUCE_FMIN:
+    return parse_reduction(t);
   case BAND:
   case BOR:
   case BXOR:
@@ -576,7 +714,18 @@ Value* Parser::parse_expr() {
   case FMAXIMUM:
   case FMINIMUM:
   case COPYSIGN:
+  case UADD_SAT:
+  case SADD_SAT:
+  case USUB_SAT:
+  case SSUB_SAT:
+  case ROTL:
+  case ROTR:
     return parse_binary(t);
+  case FSHL:
+  case FSHR:
+  case FMA:
+  case FMULADD:
+    return parse_ternary(t);
   case EQ:
   case NE:
   case ULT:
@@ -627,32 +776,45 @@ Value* Parser::parse_expr() {
     return parse_fpconv(t);
 
   case X86BINARY:
-    return parse_x86(yylval.str);
+    if (isTernaryX86(tokenizer.lexer.yylval.str))
+      return parse_x86_ter(tokenizer.lexer.yylval.str);
+    return parse_x86(tokenizer.lexer.yylval.str);
   case VAR:
     return parse_var();
   case CONST:
     return parse_const();
 
   default:
-    UNREACHABLE();
+    tokenizer.error(string("unexpected token: ") + token_name[t]);
   }
 }
 
 vector<Rewrite> Parser::parse(const llvm::Function &F, std::string_view buf) {
-  debug() << "[parser] parsing: " << buf << '\n';
+  if (isSerialized(buf)) {
+    Inst *I = deserialize(buf, Parser::F, exprs);
+    if (!I) {
+      debug(mctx) << "[parser] malformed binary rewrite\n";
+      return {};
+    }
+    debug(mctx) << "[parser] decoded: " << *I << '\n';
+    return { Rewrite(I, 0, 0) };
+  }
+
+  debug(mctx) << "[parser] parsing: " << buf << '\n';
 
-  parse::yylex_init(buf);
-  if (parse::tokenizer.empty())
-    debug()<<"[parser] cannot parse empty string\n";
+  tokenizer.init(buf);
 
   try {
+    if (tokenizer.empty()) {
+      debug(mctx)<<"[parser] cannot parse empty string\n";
+      return {};
+    }
     Inst *I = parse_expr();
     return { Rewrite(I, 0, 0) };
   } catch (ParseException &e) {
-    debug()<<"[parser] " << e.str << '\n';
-    exit(1);
-    //return {};
+    debug(mctx)<<"[parser] " << e.str << " at line " << e.lineno << '\n';
+    return {};
   }
 }
 
-}
\ No newline at end of file
+}
@@ -0,0 +1,300 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "config.h"
+#include "removal-slice.h"
+#include "utils.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/IR/BasicBlock.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Verifier.h"
+#include "llvm/Support/Casting.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Transforms/Utils/Cloning.h"
+#include "llvm/Transforms/Utils/ValueMapper.h"
+
+#include <functional>
+#include <map>
+#include <optional>
+#include <queue>
+#include <set>
+
+using namespace llvm;
+using namespace std;
+
+struct debug {
+  const minotaur::MinotaurContext &mctx;
+  debug(const minotaur::MinotaurContext &mctx) : mctx(mctx) {}
+
+  template<class T>
+  debug &operator<<(const T &s)
+  {
+    if (mctx.debug_slicer)
+      mctx.dbg()<<s;
+    return *this;
+  }
+};
+
+namespace minotaur {
+
+optional<pair<reference_wrapper<Function>, Instruction*>>
+RemovalSlice::extractExpr(Value &V) {
+  debug(mctx) << "[slicer] removal slicing value " << V << ">>>\n";
+
+  if (discarded_at_precheck) {
+    debug(mctx) << "[slicer] function has unsupported argument types\n";
+    return nullopt;
+  }
+
+  Type *vsty = V.getType()->getScalarType();
+  if (isUnsupportedTy(vsty)) {
+    debug(mctx) << "[slicer] unsupported type " << *vsty << "\n";
+    return nullopt;
+  }
+
+  assert(isa<Instruction>(&V) && "Expr to be extracted must be a Instruction");
+  Instruction *VI = cast<Instruction>(&V);
+  BasicBlock *VBB = VI->getParent();
+
+  Loop *loopv = LI.getLoopFor(VBB);
+  if (loopv && !cache.isSimplified(loopv)) {
+    debug(mctx) << "[slicer] loop is not in simplified form, skipping\n";
+    return nullopt;
+  }
+
+  // pass 1:
+  // + collect the instructions the root depends on, up to slicer_max_depth.
+  //   instructions outside the loop of the root and phis at loop headers
+  //   become arguments of the cut.
+  set<Instruction*> insts;
+  set<Value*> visited;
+  queue<pair<Instruction*, unsigned>> worklist;
+  worklist.push({VI, 0});
+  while (!worklist.empty()) {
+    auto [i, depth] = worklist.front();
+    worklist.pop();
+
+    if (depth >= mctx.slicer_max_depth)
+      continue;
+
+    if (!visited.insert(i).second)
+      continue;
+
+    BasicBlock *ibb = i->getParent();
+    if (LI.getLoopFor(ibb) != loopv)
+      continue;
+
+    auto &N = cache.getNode(i);
+    if (!N.harvestable) {
+      debug(mctx) << "[slicer] " << N.reason << "\n";
+      continue;
+    }
+
+    if (isa<PHINode>(i) && LI.isLoopHeader(ibb)) {
+      debug(mctx) << "[slicer]" << *i << " is loop-carried\n";
+      continue;
+    }
+
+    insts.insert(i);
+    for (auto &op : i->operands())
+      if (auto *op_i = dyn_cast<Instruction>(op))
+        worklist.push({op_i, depth + 1});
+  }
+
+  if (!insts.count(VI)) {
+    debug(mctx) << "[slicer] root cannot be harvested, skipping\n";
+    return nullopt;
+  }
+
+  // pass 2:
+  // + the cut starts at the nearest common dominator of the harvested
+  //   instructions, and keeps every block on the paths from there to the root
+  BasicBlock *scope = VBB;
+  for (auto i : insts) {
+    scope = DT.findNearestCommonDominator(scope, i->getParent());
+    if (auto *phi = dyn_cast<PHINode>(i))
+      for (BasicBlock *income : phi->blocks())
+        scope = DT.findNearestCommonDominator(scope, income);
+  }
+
+  auto &path = cache.getPath(VBB, scope);
+  if (!path.has_value())
+    return nullopt;
+  const set<BasicBlock*> &blocks = *path;
+  for (auto i : insts) {
+    if (!blocks.count(i->getParent())) {
+      debug(mctx) << "[slicer]" << *i << " is not on a path to the root\n";
+      return nullopt;
+    }
+  }
+
+  for (BasicBlock *bb : blocks) {
+    if (bb == VBB)
+      continue;
+    Instruction *term = bb->getTerminator();
+    if (!isa<BranchInst>(term) && !isa<SwitchInst>(term)) {
+      debug(mctx) << "[slicer] unsupported terminator " << *term << "\n";
+      return nullopt;
+    }
+    if (auto *bi = dyn_cast<BranchInst>(term))
+      if (bi->isConditional() && isa<ConstantExpr>(bi->getCondition()))
+        return nullopt;
+    if (auto *si = dyn_cast<SwitchInst>(term))
+      if (isa<ConstantExpr>(si->getCondition()))
+        return nullopt;
+  }
+
+  // pass 3:
+  // + the values used by the harvested instructions and by the branches of
+  //   the region but not harvested become function parameters, numbered in
+  //   program order so that equivalent cuts print the same
+  vector<Value*> externals;
+  map<Value*, unsigned> argMap;
+  auto addExternal = [&](Value *op) {
+    auto *op_i = dyn_cast<Instruction>(op);
+    if (!isa<Argument>(op) && !(op_i && !insts.count(op_i)))
+      return;
+    if (argMap.try_emplace(op, externals.size()).second)
+      externals.push_back(op);
+  };
+
+  vector<BasicBlock*> order = { scope };
+  for (auto &bb : VF) {
+    if (!blocks.count(&bb))
+      continue;
+    if (&bb != scope)
+      order.push_back(&bb);
+    for (auto &i : bb) {
+      if (insts.count(&i)) {
+        auto ops = i.operands();
+        if (auto *call = dyn_cast<CallInst>(&i))
+          ops = call->args();
+        for (auto &op : ops)
+          addExternal(op);
+      } else if (&bb != VBB && i.isTerminator()) {
+        if (auto *bi = dyn_cast<BranchInst>(&i); bi && bi->isConditional())
+          addExternal(bi->getCondition());
+        else if (auto *si = dyn_cast<SwitchInst>(&i))
+          addExternal(si->getCondition());
+      }
+    }
+  }
+
+  vector<Type*> argTys;
+  for (auto *ext : externals)
+    argTys.push_back(ext->getType());
+
+  Function *F = Function::Create(FunctionType::get(V.getType(), argTys, false),
+                                 GlobalValue::ExternalLinkage, "cut", *M);
+  copy_target_attributes(VF, *F);
+
+  unsigned name_count = 0;
+  for (auto &arg : F->args()) {
+    arg.setName("__n" + to_string(name_count++));
+    mapping[&arg] = externals[arg.getArgNo()];
+  }
+
+  // pass 4:
+  // + copy the blocks of the region as they are
+  ValueToValueMapTy cmap, vmap;
+  vector<pair<Instruction*, Instruction*>> copies;
+  for (BasicBlock *orig_bb : order) {
+    BasicBlock *bb = CloneBasicBlock(orig_bb, cmap, "", F);
+    bb->setName("");
+    vmap[orig_bb] = bb;
+    auto it = bb->begin();
+    for (auto &i : *orig_bb)
+      copies.push_back({&i, &*it++});
+  }
+
+  for (auto &[orig, arg] : argMap)
+    vmap[orig] = F->getArg(arg);
+
+  for (auto &[orig, copy] : copies) {
+    if (!insts.count(orig))
+      continue;
+    vmap[orig] = copy;
+    mapping[copy] = orig;
+    if (auto *call = dyn_cast<CallInst>(orig)) {
+      auto callee = call->getCalledFunction();
+      FunctionCallee intrindecl =
+          M->getOrInsertFunction(callee->getName(), callee->getFunctionType(),
+                                 callee->getAttributes());
+      vmap[callee] = intrindecl.getCallee();
+    }
+  }
+
+  // pass 5:
+  // + remove the instructions the root does not depend on
+  // + remap the rest, branches leaving the region or going back are sent to
+  //   the sink
+  BasicBlock *sinkbb = nullptr;
+  vector<Instruction*> removed;
+  for (auto &[orig, copy] : copies) {
+    if (insts.count(orig)) {
+      RemapInstruction(copy, vmap, RF_IgnoreMissingLocals);
+      copy->setName("__n" + to_string(name_count++));
+    } else if (orig->isTerminator() && orig->getParent() != VBB) {
+      RemapInstruction(copy, vmap, RF_IgnoreMissingLocals);
+      for (unsigned s = 0; s < orig->getNumSuccessors(); ++s) {
+        BasicBlock *succ = orig->getSuccessor(s);
+        if (blocks.count(succ) && !cache.isBackEdge(orig->getParent(), succ))
+          continue;
+        if (!sinkbb) {
+          sinkbb = BasicBlock::Create(Ctx, "sink");
+          new UnreachableInst(Ctx, sinkbb);
+        }
+        copy->setSuccessor(s, sinkbb);
+      }
+    } else {
+      removed.push_back(copy);
+    }
+  }
+
+  for (auto *i : removed)
+    i->dropAllReferences();
+  for (auto *i : removed) {
+    i->replaceAllUsesWith(PoisonValue::get(i->getType()));
+    i->eraseFromParent();
+  }
+
+  if (sinkbb)
+    sinkbb->insertInto(F);
+
+  BasicBlock *retbb = cast<BasicBlock>(vmap[VBB]);
+  ReturnInst::Create(Ctx, cache.demandedRoot(VI, vmap[VI], retbb), retbb);
+
+  DominatorTree FDT = DominatorTree();
+  FDT.recalculate(*F);
+  LoopInfoBase<BasicBlock, Loop> FLI;
+  FLI.analyze(FDT);
+
+  // make sure sliced function is loop free.
+  if (!FLI.empty())
+    report_fatal_error("[slicer] a loop is generated, terminating\n");
+
+  eliminate_dead_code(*F);
+  // validate the created function
+  string err;
+  raw_string_ostream err_stream(err);
+  bool illformed = verifyFunction(*F, &err_stream);
+  if (illformed) {
+    llvm::errs() << err << "\n" << *F;
+    report_fatal_error("[slicer] illformed function generated, terminating\n");
+  }
+
+  debug(mctx) << "[slicer] " << insts.size() << " instructions and "
+              << blocks.size() << " blocks are kept\n";
+  debug(mctx) << *F << "\n" << "<<< end of %" << V.getName() << " <<<\n";
+
+  return pair<reference_wrapper<Function>, Instruction*>(*F,
+    cast<Instruction>(vmap[VI]));
+}
+
+} // namespace minotaur
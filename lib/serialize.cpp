@@ -0,0 +1,611 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "serialize.h"
+
+#include "llvm/ADT/APFloat.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Support/LEB128.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <map>
+#include <tuple>
+
+using namespace std;
+using namespace llvm;
+using namespace minotaur;
+
+// layout, all integers are unsigned LEB128 unless noted
+//
+//   magic "\x7fMNT", version
+//   #types,   then (lane, bits, fp) per type
+//   #strings, then (length, bytes) per string
+//   #nodes,   then one node per entry, the root comes last
+//
+// a node starts with a one-byte kind followed by its fields. types and
+// strings (variable and intrinsic names) are indices into the tables, and
+// operands are indices of earlier nodes, so shared subtrees and repeated
+// variables are stored once.
+//
+// the value of a reserved constant is stored per element, as 0 for poison,
+// 1 for undef and otherwise the zigzag-encoded integer or the raw bits of
+// the floating point value, plus two. constants that do not fit the scheme
+// are stored as text and re-parsed.
+//
+// version 1 had no flags on binary operations, its entries are still read
+// and decode without flags.
+
+namespace {
+
+constexpr char MAGIC[] = "\x7fMNT";
+constexpr unsigned MAGIC_LEN = 4;
+
+enum NodeKind : uint8_t {
+  N_Var, N_ReservedConst, N_Copy, N_UnaryOp, N_BinaryOp, N_ICmp, N_FCmp,
+  N_SIMDBinOp, N_Shuffle, N_ExtractElement, N_InsertElement,
+  N_IntConversion, N_FPConversion, N_Select, N_SIMDTerOp, N_Reduction,
+  N_TernaryOp
+};
+
+enum ConstKind : uint8_t {
+  C_Null, C_Int, C_FP, C_Text
+};
+
+uint64_t zigzag(int64_t v) {
+  return (uint64_t(v) << 1) ^ uint64_t(v >> 63);
+}
+
+int64_t unzigzag(uint64_t v) {
+  return int64_t(v >> 1) ^ -int64_t(v & 1);
+}
+
+class Writer {
+  string types, strings, nodes;
+  unsigned ntypes = 0, nstrings = 0, nnodes = 0;
+
+  map<tuple<unsigned, unsigned, bool>, unsigned> TypeIdx;
+  StringMap<unsigned> StringIdx;
+  DenseMap<Inst*, unsigned> NodeIdx;
+
+  void u(string &s, uint64_t v) {
+    raw_string_ostream os(s);
+    encodeULEB128(v, os);
+  }
+
+  unsigned typeRef(type t) {
+    auto key = make_tuple(t.getLane(), t.getBits(), t.isFP());
+    auto [it, inserted] = TypeIdx.try_emplace(key, ntypes);
+    if (inserted) {
+      u(types, t.getLane());
+      u(types, t.getBits());
+      types.push_back(t.isFP());
+      ++ntypes;
+    }
+    return it->second;
+  }
+
+  unsigned stringRef(StringRef str) {
+    auto [it, inserted] = StringIdx.try_emplace(str, nstrings);
+    if (inserted) {
+      u(strings, str.size());
+      strings.append(str.data(), str.size());
+      ++nstrings;
+    }
+    return it->second;
+  }
+
+  bool writeElement(string &s, Constant *E) {
+    if (isa<PoisonValue>(E)) {
+      u(s, 0);
+    } else if (isa<UndefValue>(E)) {
+      u(s, 1);
+    } else if (auto CI = dyn_cast<ConstantInt>(E)) {
+      if (CI->getBitWidth() > 64)
+        return false;
+      u(s, zigzag(CI->getSExtValue()) + 2);
+    } else if (auto CF = dyn_cast<ConstantFP>(E)) {
+      APInt bits = CF->getValueAPF().bitcastToAPInt();
+      if (bits.getBitWidth() > 64)
+        return false;
+      uint64_t raw = bits.getZExtValue();
+      if (raw > UINT64_MAX - 2)
+        return false;
+      u(s, raw + 2);
+    } else {
+      return false;
+    }
+    return true;
+  }
+
+  void writeConst(string &s, Constant *C) {
+    if (!C) {
+      s.push_back(C_Null);
+      return;
+    }
+
+    Type *Ty = C->getType();
+    Type *ElemTy = Ty->getScalarType();
+    bool IsVec = Ty->isVectorTy();
+    if ((ElemTy->isIntegerTy() || ElemTy->isIEEELikeFPTy()) &&
+        !isa<ScalableVectorType>(Ty)) {
+      string elems;
+      bool ok = true;
+      unsigned lanes = IsVec ? cast<FixedVectorType>(Ty)->getNumElements() : 1;
+      for (unsigned i = 0; ok && i < lanes; ++i) {
+        Constant *E = IsVec ? C->getAggregateElement(i) : C;
+        ok = E && writeElement(elems, E);
+      }
+      if (ok) {
+        s.push_back(ElemTy->isIntegerTy() ? C_Int : C_FP);
+        u(s, typeRef(type(Ty)));
+        s.push_back(IsVec);
+        s += elems;
+        return;
+      }
+    }
+
+    string text;
+    raw_string_ostream os(text);
+    C->print(os);
+    os.flush();
+    s.push_back(C_Text);
+    u(s, stringRef(text));
+  }
+
+public:
+  unsigned write(Inst *I) {
+    if (auto it = NodeIdx.find(I); it != NodeIdx.end())
+      return it->second;
+
+    string n;
+    if (auto V = dynamic_cast<Var*>(I)) {
+      n.push_back(N_Var);
+      u(n, typeRef(V->getType()));
+      u(n, stringRef(V->getName()));
+    } else if (auto RC = dynamic_cast<ReservedConst*>(I)) {
+      n.push_back(N_ReservedConst);
+      u(n, typeRef(RC->getType()));
+      writeConst(n, RC->getC());
+    } else if (auto CP = dynamic_cast<Copy*>(I)) {
+      unsigned rc = write(CP->V());
+      n.push_back(N_Copy);
+      u(n, rc);
+    } else if (auto U = dynamic_cast<UnaryOp*>(I)) {
+      unsigned v = write(U->V());
+      n.push_back(N_UnaryOp);
+      u(n, U->K());
+      u(n, typeRef(U->getWorkTy()));
+      u(n, v);
+    } else if (auto R = dynamic_cast<Reduction*>(I)) {
+      unsigned v = write(R->V());
+      n.push_back(N_Reduction);
+      u(n, R->K());
+      u(n, typeRef(R->getWorkTy()));
+      u(n, v);
+    } else if (auto B = dynamic_cast<BinaryOp*>(I)) {
+      unsigned l = write(B->L()), r = write(B->R());
+      n.push_back(N_BinaryOp);
+      u(n, B->K());
+      u(n, B->getFlags());
+      u(n, typeRef(B->getWorkTy()));
+      u(n, l);
+      u(n, r);
+    } else if (auto T = dynamic_cast<TernaryOp*>(I)) {
+      unsigned a = write(T->A()), b = write(T->B()), c = write(T->C());
+      n.push_back(N_TernaryOp);
+      u(n, T->K());
+      u(n, typeRef(T->getWorkTy()));
+      u(n, a);
+      u(n, b);
+      u(n, c);
+    } else if (auto IC = dynamic_cast<ICmp*>(I)) {
+      unsigned l = write(IC->L()), r = write(IC->R());
+      n.push_back(N_ICmp);
+      u(n, IC->K());
+      u(n, IC->getLanes());
+      u(n, l);
+      u(n, r);
+    } else if (auto FC = dynamic_cast<FCmp*>(I)) {
+      unsigned l = write(FC->L()), r = write(FC->R());
+      n.push_back(N_FCmp);
+      u(n, FC->K());
+      u(n, FC->getLanes());
+      u(n, l);
+      u(n, r);
+    } else if (auto SI = dynamic_cast<SIMDBinOpInst*>(I)) {
+      unsigned l = write(SI->L()), r = write(SI->R());
+      n.push_back(N_SIMDBinOp);
+      u(n, stringRef(IR::X86IntrinBinOp::getOpName(SI->K())));
+      u(n, l);
+      u(n, r);
+    } else if (auto TI = dynamic_cast<SIMDTerOpInst*>(I)) {
+      unsigned a = write(TI->A()), b = write(TI->B()), c = write(TI->C());
+      n.push_back(N_SIMDTerOp);
+      u(n, stringRef(IR::X86IntrinTerOp::getOpName(TI->K())));
+      u(n, a);
+      u(n, b);
+      u(n, c);
+    } else if (auto FS = dynamic_cast<FakeShuffleInst*>(I)) {
+      unsigned l = write(FS->L());
+      // 0 encodes a missing rhs, other operands are shifted by one
+      unsigned r = FS->R() ? write(FS->R()) + 1 : 0;
+      unsigned m = write(FS->M());
+      n.push_back(N_Shuffle);
+      u(n, typeRef(FS->getType()));
+      u(n, l);
+      u(n, r);
+      u(n, m);
+    } else if (auto EE = dynamic_cast<ExtractElement*>(I)) {
+      unsigned v = write(EE->V()), idx = write(EE->Idx());
+      n.push_back(N_ExtractElement);
+      u(n, typeRef(EE->getType()));
+      u(n, v);
+      u(n, idx);
+    } else if (auto IE = dynamic_cast<InsertElement*>(I)) {
+      unsigned v = write(IE->V()), e = write(IE->Elt());
+      unsigned idx = write(IE->Idx());
+      n.push_back(N_InsertElement);
+      u(n, typeRef(IE->getType()));
+      u(n, v);
+      u(n, e);
+      u(n, idx);
+    } else if (auto IC = dynamic_cast<IntConversion*>(I)) {
+      unsigned v = write(IC->V());
+      n.push_back(N_IntConversion);
+      u(n, IC->K());
+      u(n, typeRef(IC->getPrevTy()));
+      u(n, typeRef(IC->getNewTy()));
+      u(n, v);
+    } else if (auto FC = dynamic_cast<FPConversion*>(I)) {
+      unsigned v = write(FC->V());
+      n.push_back(N_FPConversion);
+      u(n, FC->K());
+      u(n, typeRef(FC->getType()));
+      u(n, v);
+    } else if (auto S = dynamic_cast<Select*>(I)) {
+      unsigned c = write(S->Cond()), l = write(S->L()), r = write(S->R());
+      n.push_back(N_Select);
+      u(n, c);
+      u(n, l);
+      u(n, r);
+    } else {
+      report_fatal_error("[serialize] unknown instruction");
+    }
+
+    nodes += n;
+    NodeIdx[I] = nnodes;
+    return nnodes++;
+  }
+
+  string finish() {
+    string out(MAGIC, MAGIC_LEN);
+    u(out, SERIALIZE_VERSION);
+    u(out, ntypes);
+    out += types;
+    u(out, nstrings);
+    out += strings;
+    u(out, nnodes);
+    out += nodes;
+    return out;
+  }
+};
+
+struct DecodeError {};
+
+class Reader {
+  const uint8_t *p, *end;
+  uint64_t version = 0;
+  Function &F;
+  vector<unique_ptr<Inst>> &exprs;
+
+  vector<type> types;
+  vector<string_view> strings;
+  vector<minotaur::Value*> nodes;
+
+  uint64_t u() {
+    const char *err = nullptr;
+    unsigned n = 0;
+    uint64_t v = decodeULEB128(p, &n, end, &err);
+    if (err)
+      throw DecodeError();
+    p += n;
+    return v;
+  }
+
+  uint8_t byte() {
+    if (p == end)
+      throw DecodeError();
+    return *p++;
+  }
+
+  template<typename E>
+  E op(unsigned count) {
+    uint64_t v = u();
+    if (v >= count)
+      throw DecodeError();
+    return static_cast<E>(v);
+  }
+
+  type typeRef() {
+    uint64_t i = u();
+    if (i >= types.size())
+      throw DecodeError();
+    return types[i];
+  }
+
+  string_view stringRef() {
+    uint64_t i = u();
+    if (i >= strings.size())
+      throw DecodeError();
+    return strings[i];
+  }
+
+  minotaur::Value *nodeRef() {
+    uint64_t i = u();
+    if (i >= nodes.size())
+      throw DecodeError();
+    return nodes[i];
+  }
+
+  ReservedConst *constRef() {
+    auto RC = dynamic_cast<ReservedConst*>(nodeRef());
+    if (!RC)
+      throw DecodeError();
+    return RC;
+  }
+
+  template<typename T, typename... Args>
+  T *make(Args&&... args) {
+    auto N = make_unique<T>(std::forward<Args>(args)...);
+    T *R = N.get();
+    exprs.emplace_back(std::move(N));
+    return R;
+  }
+
+  Constant *readConst() {
+    LLVMContext &C = F.getContext();
+    uint8_t kind = byte();
+    switch (kind) {
+    case C_Null:
+      return nullptr;
+    case C_Text: {
+      string text(stringRef());
+      SMDiagnostic diag;
+      Constant *K = parseConstantValue(text, diag, *F.getParent());
+      if (!K)
+        throw DecodeError();
+      return K;
+    }
+    case C_Int:
+    case C_FP: {
+      type t = typeRef();
+      bool IsVec = byte();
+      if (!t.isValid() || (kind == C_FP) != t.isFP() || t.getBits() > 64)
+        throw DecodeError();
+      Type *ElemTy = type::Scalar(t.getBits(), t.isFP()).toLLVM(C);
+      SmallVector<Constant*, 16> Elems;
+      for (unsigned i = 0; i < t.getLane(); ++i) {
+        uint64_t v = u();
+        if (v == 0)
+          Elems.push_back(PoisonValue::get(ElemTy));
+        else if (v == 1)
+          Elems.push_back(UndefValue::get(ElemTy));
+        else if (kind == C_Int)
+          Elems.push_back(ConstantInt::get(ElemTy,
+            APInt(t.getBits(), unzigzag(v - 2), true)));
+        else
+          Elems.push_back(ConstantFP::get(C,
+            APFloat(ElemTy->getFltSemantics(), APInt(t.getBits(), v - 2))));
+      }
+      if (!IsVec) {
+        if (Elems.size() != 1)
+          throw DecodeError();
+        return Elems[0];
+      }
+      return ConstantVector::get(Elems);
+    }
+    default:
+      throw DecodeError();
+    }
+  }
+
+  minotaur::Value *readNode() {
+    switch (byte()) {
+    case N_Var: {
+      type t = typeRef();
+      string name(stringRef());
+      if (name.empty() || name[0] != '%')
+        throw DecodeError();
+      llvm::Value *LV = F.getValueSymbolTable()->lookup(name.substr(1));
+      if (!LV || !(type(LV->getType()) == t))
+        throw DecodeError();
+      return make<Var>(LV);
+    }
+    case N_ReservedConst: {
+      type t = typeRef();
+      return make<ReservedConst>(t, readConst());
+    }
+    case N_Copy:
+      return make<Copy>(*constRef());
+    case N_UnaryOp: {
+      auto k = op<UnaryOp::Op>(UnaryOp::abs + 1);
+      type workty = typeRef();
+      return make<UnaryOp>(k, *nodeRef(), workty);
+    }
+    case N_Reduction: {
+      auto k = op<Reduction::Op>(Reduction::fmin + 1);
+      type workty = typeRef();
+      return make<Reduction>(k, *nodeRef(), workty);
+    }
+    case N_BinaryOp: {
+      auto k = op<BinaryOp::Op>(BinaryOp::rotr + 1);
+      uint64_t flags = version >= 2 ? u() : 0;
+      if (flags & ~uint64_t(BinaryOp::allowedFlags(k)))
+        throw DecodeError();
+      type workty = typeRef();
+      auto l = nodeRef();
+      auto r = nodeRef();
+      auto *B = make<BinaryOp>(k, *l, *r, workty);
+      B->setFlags(flags);
+      return B;
+    }
+    case N_TernaryOp: {
+      auto k = op<TernaryOp::Op>(TernaryOp::fmuladd + 1);
+      type workty = typeRef();
+      auto a = nodeRef();
+      auto b = nodeRef();
+      auto c = nodeRef();
+      return make<TernaryOp>(k, *a, *b, *c, workty);
+    }
+    case N_ICmp: {
+      auto k = op<ICmp::Cond>(ICmp::sge + 1);
+      unsigned lanes = u();
+      auto l = nodeRef();
+      auto r = nodeRef();
+      return make<ICmp>(k, *l, *r, lanes);
+    }
+    case N_FCmp: {
+      auto k = op<FCmp::Cond>(FCmp::t + 1);
+      unsigned lanes = u();
+      auto l = nodeRef();
+      auto r = nodeRef();
+      return make<FCmp>(k, *l, *r, lanes);
+    }
+    case N_SIMDBinOp: {
+      string_view name = stringRef();
+      optional<IR::X86IntrinBinOp::Op> k;
+      #define PROCESS(NAME,A,B,C,D,E,F) \
+        if (name == #NAME) k = IR::X86IntrinBinOp::NAME;
+      #include "ir/intrinsics_binop.h"
+      #undef PROCESS
+      if (!k)
+        throw DecodeError();
+      auto l = nodeRef();
+      auto r = nodeRef();
+      return make<SIMDBinOpInst>(*k, *l, *r);
+    }
+    case N_SIMDTerOp: {
+      string_view name = stringRef();
+      optional<IR::X86IntrinTerOp::Op> k;
+      #define PROCESS(NAME,A,B,C,D,E,F,G,H) \
+        if (name == #NAME) k = IR::X86IntrinTerOp::NAME;
+      #include "ir/intrinsics_terop.h"
+      #undef PROCESS
+      if (!k)
+        throw DecodeError();
+      auto a = nodeRef();
+      auto b = nodeRef();
+      auto c = nodeRef();
+      return make<SIMDTerOpInst>(*k, *a, *b, *c);
+    }
+    case N_Shuffle: {
+      type t = typeRef();
+      auto l = nodeRef();
+      uint64_t ri = u();
+      if (ri > nodes.size())
+        throw DecodeError();
+      minotaur::Value *r = ri ? nodes[ri - 1] : nullptr;
+      return make<FakeShuffleInst>(*l, r, *constRef(), t);
+    }
+    case N_ExtractElement: {
+      type t = typeRef();
+      auto v = nodeRef();
+      return make<ExtractElement>(*v, *constRef(), t);
+    }
+    case N_InsertElement: {
+      type t = typeRef();
+      auto v = nodeRef();
+      auto e = nodeRef();
+      return make<InsertElement>(*v, *e, *constRef(), t);
+    }
+    case N_IntConversion: {
+      auto k = op<IntConversion::Op>(IntConversion::trunc + 1);
+      type from = typeRef();
+      type to = typeRef();
+      return make<IntConversion>(k, *nodeRef(), from.getLane(),
+                                 from.getBits(), to.getBits());
+    }
+    case N_FPConversion: {
+      auto k = op<FPConversion::Op>(FPConversion::sitofp + 1);
+      type t = typeRef();
+      return make<FPConversion>(k, *nodeRef(), t);
+    }
+    case N_Select: {
+      auto c = nodeRef();
+      auto l = nodeRef();
+      auto r = nodeRef();
+      return make<Select>(*c, *l, *r);
+    }
+    default:
+      throw DecodeError();
+    }
+  }
+
+public:
+  Reader(string_view buf, Function &F,
+         vector<unique_ptr<Inst>> &exprs)
+    : p((const uint8_t*)buf.data()), end((const uint8_t*)buf.data() + buf.size()),
+      F(F), exprs(exprs) {}
+
+  Inst *read() {
+    p += MAGIC_LEN;
+    version = u();
+    if (version < 1 || version > SERIALIZE_VERSION)
+      throw DecodeError();
+
+    for (uint64_t i = 0, n = u(); i < n; ++i) {
+      unsigned lane = u(), bits = u();
+      bool fp = byte();
+      types.push_back(type::Vectorizable(lane, bits, fp));
+    }
+
+    for (uint64_t i = 0, n = u(); i < n; ++i) {
+      uint64_t len = u();
+      if (len > uint64_t(end - p))
+        throw DecodeError();
+      strings.emplace_back((const char*)p, len);
+      p += len;
+    }
+
+    uint64_t n = u();
+    if (n == 0)
+      throw DecodeError();
+    for (uint64_t i = 0; i < n; ++i)
+      nodes.push_back(readNode());
+
+    if (p != end)
+      throw DecodeError();
+    return nodes.back();
+  }
+};
+
+} // namespace
+
+namespace minotaur {
+
+bool isSerialized(string_view buf) {
+  return buf.size() > MAGIC_LEN && buf.substr(0, MAGIC_LEN) == MAGIC;
+}
+
+string serialize(Inst *I) {
+  Writer W;
+  W.write(I);
+  return W.finish();
+}
+
+Inst *deserialize(string_view buf, Function &F,
+                  vector<unique_ptr<Inst>> &exprs) {
+  if (!isSerialized(buf))
+    return nullptr;
+  try {
+    return Reader(buf, F, exprs).read();
+  } catch (DecodeError&) {
+    return nullptr;
+  }
+}
+
+} // namespace minotaur
@@ -0,0 +1,238 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "sketch.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace std;
+
+namespace minotaur {
+
+namespace {
+
+class Binder {
+  unordered_map<Value*, Value*> slots;
+  unordered_map<ReservedConst*, ReservedConst*> consts;
+  vector<unique_ptr<Inst>> &exprs;
+
+  template<typename T, typename... Args>
+  T *make(Args&&... args) {
+    auto N = make_unique<T>(std::forward<Args>(args)...);
+    T *R = N.get();
+    exprs.emplace_back(std::move(N));
+    return R;
+  }
+
+public:
+  Binder(const SketchTemplate &T, const vector<Var*> &inputs,
+         vector<unique_ptr<Inst>> &exprs) : exprs(exprs) {
+    for (unsigned i = 0; i < T.slots.size(); ++i)
+      slots[T.slots[i]] = inputs[i];
+  }
+
+  // reserved constants are shared within a sketch, not across sketches
+  void reset() { consts.clear(); }
+
+  ReservedConst *bindConst(ReservedConst *RC) {
+    auto &C = consts[RC];
+    if (!C)
+      C = make<ReservedConst>(RC->getType());
+    return C;
+  }
+
+  Value *bind(Inst *I) {
+    if (!I)
+      return nullptr;
+
+    if (auto V = dynamic_cast<Var*>(I)) {
+      auto it = slots.find(V);
+      if (it == slots.end())
+        llvm::report_fatal_error("[sketch] unbound variable in template");
+      return it->second;
+    } else if (auto RC = dynamic_cast<ReservedConst*>(I)) {
+      return bindConst(RC);
+    } else if (auto CP = dynamic_cast<Copy*>(I)) {
+      return make<Copy>(*bindConst(CP->V()));
+    } else if (auto U = dynamic_cast<UnaryOp*>(I)) {
+      type workty = U->getWorkTy();
+      return make<UnaryOp>(U->K(), *bind(U->V()), workty);
+    } else if (auto R = dynamic_cast<Reduction*>(I)) {
+      type workty = R->getWorkTy();
+      return make<Reduction>(R->K(), *bind(R->V()), workty);
+    } else if (auto B = dynamic_cast<BinaryOp*>(I)) {
+      type workty = B->getWorkTy();
+      auto l = bind(B->L());
+      auto r = bind(B->R());
+      auto *BO = make<BinaryOp>(B->K(), *l, *r, workty);
+      BO->setFlags(B->getFlags());
+      return BO;
+    } else if (auto T = dynamic_cast<TernaryOp*>(I)) {
+      type workty = T->getWorkTy();
+      auto a = bind(T->A());
+      auto b = bind(T->B());
+      auto c = bind(T->C());
+      return make<TernaryOp>(T->K(), *a, *b, *c, workty);
+    } else if (auto IC = dynamic_cast<ICmp*>(I)) {
+      auto l = bind(IC->L());
+      auto r = bind(IC->R());
+      return make<ICmp>(IC->K(), *l, *r, IC->getLanes());
+    } else if (auto FC = dynamic_cast<FCmp*>(I)) {
+      auto l = bind(FC->L());
+      auto r = bind(FC->R());
+      return make<FCmp>(FC->K(), *l, *r, FC->getLanes());
+    } else if (auto SI = dynamic_cast<SIMDBinOpInst*>(I)) {
+      auto l = bind(SI->L());
+      auto r = bind(SI->R());
+      return make<SIMDBinOpInst>(SI->K(), *l, *r);
+    } else if (auto TI = dynamic_cast<SIMDTerOpInst*>(I)) {
+      auto a = bind(TI->A());
+      auto b = bind(TI->B());
+      auto c = bind(TI->C());
+      return make<SIMDTerOpInst>(TI->K(), *a, *b, *c);
+    } else if (auto FS = dynamic_cast<FakeShuffleInst*>(I)) {
+      type ety = FS->getType();
+      auto l = bind(FS->L());
+      auto r = bind(FS->R());
+      return make<FakeShuffleInst>(*l, r, *bindConst(FS->M()), ety);
+    } else if (auto EE = dynamic_cast<ExtractElement*>(I)) {
+      type ety = EE->getType();
+      return make<ExtractElement>(*bind(EE->V()), *bindConst(EE->Idx()), ety);
+    } else if (auto IE = dynamic_cast<InsertElement*>(I)) {
+      type ety = IE->getType();
+      auto v = bind(IE->V());
+      auto e = bind(IE->Elt());
+      return make<InsertElement>(*v, *e, *bindConst(IE->Idx()), ety);
+    } else if (auto IC = dynamic_cast<IntConversion*>(I)) {
+      type prev = IC->getPrevTy(), next = IC->getNewTy();
+      return make<IntConversion>(IC->K(), *bind(IC->V()), prev.getLane(),
+                                 prev.getBits(), next.getBits());
+    } else if (auto FC = dynamic_cast<FPConversion*>(I)) {
+      type ty = FC->getType();
+      return make<FPConversion>(FC->K(), *bind(FC->V()), ty);
+    } else if (auto S = dynamic_cast<Select*>(I)) {
+      auto c = bind(S->Cond());
+      auto l = bind(S->L());
+      auto r = bind(S->R());
+      return make<Select>(*c, *l, *r);
+    }
+    llvm::report_fatal_error("[sketch] unknown instruction in template");
+  }
+};
+
+}
+
+llvm::SmallVector<Value*, 3> operands(Inst *I) {
+  if (auto CP = dynamic_cast<Copy*>(I))
+    return { CP->V() };
+  if (auto U = dynamic_cast<UnaryOp*>(I))
+    return { U->V() };
+  if (auto R = dynamic_cast<Reduction*>(I))
+    return { R->V() };
+  if (auto B = dynamic_cast<BinaryOp*>(I))
+    return { B->L(), B->R() };
+  if (auto T = dynamic_cast<TernaryOp*>(I))
+    return { T->A(), T->B(), T->C() };
+  if (auto IC = dynamic_cast<ICmp*>(I))
+    return { IC->L(), IC->R() };
+  if (auto FC = dynamic_cast<FCmp*>(I))
+    return { FC->L(), FC->R() };
+  if (auto SI = dynamic_cast<SIMDBinOpInst*>(I))
+    return { SI->L(), SI->R() };
+  if (auto TI = dynamic_cast<SIMDTerOpInst*>(I))
+    return { TI->A(), TI->B(), TI->C() };
+  if (auto FS = dynamic_cast<FakeShuffleInst*>(I)) {
+    if (FS->R())
+      return { FS->L(), FS->R(), FS->M() };
+    return { FS->L(), FS->M() };
+  }
+  if (auto EE = dynamic_cast<ExtractElement*>(I))
+    return { EE->V(), EE->Idx() };
+  if (auto IE = dynamic_cast<InsertElement*>(I))
+    return { IE->V(), IE->Elt(), IE->Idx() };
+  if (auto IC = dynamic_cast<IntConversion*>(I))
+    return { IC->V() };
+  if (auto FC = dynamic_cast<FPConversion*>(I))
+    return { FC->V() };
+  if (auto S = dynamic_cast<Select*>(I))
+    return { S->Cond(), S->L(), S->R() };
+  return {};
+}
+
+Tier tierOf(const Sketch &S) {
+  Inst *I = S.first;
+  if (dynamic_cast<Var*>(I))
+    return Tier::Trivial;
+  // a copied constant still needs a synthesis query
+  if (dynamic_cast<Copy*>(I))
+    return Tier::Holes;
+  if (dynamic_cast<SIMDBinOpInst*>(I) || dynamic_cast<SIMDTerOpInst*>(I))
+    return Tier::Complex;
+  for (auto *Op : operands(I))
+    if (!dynamic_cast<Var*>(Op) && !dynamic_cast<ReservedConst*>(Op))
+      return Tier::Complex;
+  return S.second.empty() ? Tier::SingleOp : Tier::Holes;
+}
+
+void instantiate(const SketchTemplate &T, const vector<Var*> &inputs,
+                 vector<Sketch> &sketches, vector<unique_ptr<Inst>> &exprs,
+                 optional<Tier> Only) {
+  assert(inputs.size() == T.slots.size());
+  Binder B(T, inputs, exprs);
+  for (unsigned i = 0; i < T.sketches.size(); ++i) {
+    if (Only && T.tiers[i] != *Only)
+      continue;
+    auto &[I, RCs] = T.sketches[i];
+    B.reset();
+    Inst *R = B.bind(I);
+    set<ReservedConst*> Bound;
+    for (auto *RC : RCs)
+      Bound.insert(B.bindConst(RC));
+    sketches.emplace_back(R, std::move(Bound));
+  }
+}
+
+SketchCache &SketchCache::get() {
+  static SketchCache Cache;
+  return Cache;
+}
+
+string SketchCache::key(const vector<Var*> &inputs, type expected,
+                        const string &features, llvm::FastMathFlags FMF) {
+  string str;
+  llvm::raw_string_ostream os(str);
+  os << expected << " [" << features << "]";
+  FMF.print(os);
+  os << " <-";
+  for (auto *In : inputs)
+    os << " " << In->getType();
+  os.flush();
+  return str;
+}
+
+shared_ptr<const SketchTemplate> SketchCache::lookup(const string &key) {
+  lock_guard<mutex> guard(lock);
+  auto it = templates.find(key);
+  if (it == templates.end()) {
+    ++misses;
+    return nullptr;
+  }
+  ++hits;
+  return it->second;
+}
+
+void SketchCache::insert(const string &key,
+                         shared_ptr<const SketchTemplate> T) {
+  lock_guard<mutex> guard(lock);
+  if (templates.size() >= MaxTemplates)
+    templates.clear();
+  templates.emplace(key, std::move(T));
+}
+
+pair<unsigned, unsigned> SketchCache::stats() {
+  lock_guard<mutex> guard(lock);
+  return {hits, misses};
+}
+
+} // namespace minotaur
@@ -4,6 +4,8 @@
 #include "slice.h"
 #include "utils.h"
 
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/PostOrderIterator.h"
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/IR/BasicBlock.h"
 #include "llvm/IR/CFG.h"
@@ -13,6 +15,7 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instruction.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/Intrinsics.h"
@@ -31,84 +34,274 @@ using namespace llvm;
 using namespace std;
 
 struct debug {
+  const minotaur::MinotaurContext &mctx;
+  debug(const minotaur::MinotaurContext &mctx) : mctx(mctx) {}
+
   template<class T>
   debug &operator<<(const T &s)
   {
-    if (minotaur::config::debug_slicer)
-      minotaur::config::dbg()<<s;
+    if (mctx.debug_slicer)
+      mctx.dbg()<<s;
     return *this;
   }
 };
 
-static bool isUnsupportedTy(llvm::Type *ty) {
+// the slicer gives up on blocks farther than this from the root along any
+// path of the CFG
+static constexpr unsigned MAX_PATH_BLOCKS = 20;
+
+// roots are only cut together with the instructions that follow them closely
+static constexpr unsigned MAX_ROOT_DISTANCE = 16;
+
+namespace minotaur {
+
+bool isUnsupportedTy(llvm::Type *ty) {
   Type *vsty = ty->getScalarType();
   return ty->isStructTy() || vsty->isPointerTy() ||
          (vsty->isFloatingPointTy() && !vsty->isIEEELikeFPTy()) ||
          ty->isScalableTy() || vsty->isX86_MMXTy() || vsty->isX86_AMXTy();
 }
 
-static bool walk(BasicBlock* current, BasicBlock* target,
-                 set<BasicBlock*> &blocks,
-                 DominatorTree &DT) {
-  auto s = [&DT](auto self,
-                 BasicBlock* current,
-                 BasicBlock* target,
-                 set<BasicBlock*>& visited,
-                 set<BasicBlock*>& result) -> bool {
-    if (visited.size() > 20) {
-      debug() << "[slicer] block too distant from root, skipping\n";
-      return false;
+vector<vector<Instruction*>> relatedRoots(BasicBlock &bb) {
+  vector<vector<Instruction*>> groups;
+  set<Instruction*> paired;
+  for (auto &i : bb) {
+    if (i.getType()->isVoidTy() || isUnsupportedTy(i.getType()) ||
+        paired.count(&i))
+      continue;
+    set<Value*> ops;
+    for (auto &op : i.operands())
+      if (isa<Instruction>(op) || isa<Argument>(op))
+        ops.insert(op);
+
+    unsigned distance = 0;
+    for (auto j = next(i.getIterator());
+         j != bb.end() && distance < MAX_ROOT_DISTANCE; ++j, ++distance) {
+      if (j->getType() != i.getType() || paired.count(&*j))
+        continue;
+      if (none_of(j->operands(), [&ops](Use &op) { return ops.count(op); }))
+        continue;
+      groups.push_back({&i, &*j});
+      paired.insert(&i);
+      paired.insert(&*j);
+      break;
     }
+  }
+  return groups;
+}
 
-    if (target == current) {
-        result.insert(visited.begin(), visited.end());
-        return true;
-    } else {
-      for (BasicBlock* pred : predecessors(current)) {
-        bool t = true;
-        if (visited.find(pred) == visited.end() && DT.dominates(target, pred)) {
-            visited.insert(pred);  // Backtrack
-            t = self(self, pred, target, visited, result);
-            visited.erase(pred);
-        }
-        if (!t)
-          return false;
+const SliceCache::Node &SliceCache::getNode(Instruction *i) {
+  auto it = nodes.find(i);
+  if (it != nodes.end())
+    return it->second;
+
+  Node &N = nodes[i];
+  N.harvestable = false;
+  auto ops = i->operands();
+
+  // filter unknown operation by instruction
+  if (CallInst *call = dyn_cast<CallInst>(i)) {
+    auto callee = call->getCalledFunction();
+    if (!callee) {
+      N.reason = "unknown callee";
+      return N;
+    }
+    if (!callee->isIntrinsic()) {
+      N.reason = "non-intrinsic call: " + callee->getName().str();
+      return N;
+    }
+    ops = call->args();
+  }
+
+  // filter unknown operation by operand type
+  for (auto &op : ops) {
+    if (isa<GlobalValue>(op)) {
+      N.reason = "found instruction that uses GlobalValue";
+      return N;
+    }
+    if (isa<ConstantExpr>(op)) {
+      N.reason = "found instruction that uses ConstantExpr";
+      return N;
+    }
+    // give up <i31 34, i31 ptrtoint (ptr @external_global to i31)>
+    if (auto c = dyn_cast<Constant>(op)) {
+      if (c->containsConstantExpression()) {
+        N.reason = "found constant that contains ConstantExpr";
+        return N;
       }
-      return true;
     }
-  };
-  /*debug () << "[slicer] start walking from " << current->getName() << " to "
-           << target->getName() << "\n";*/
+    auto op_ty = op->getType();
+    if (isUnsupportedTy(op_ty)) {
+      raw_string_ostream rs(N.reason);
+      rs << "found instruction with operands with type " << *op_ty;
+      rs.flush();
+      return N;
+    }
+  }
+
+  N.harvestable = true;
+  return N;
+}
 
-  set<BasicBlock*> visited = { current };
+Value *SliceCache::demandedRoot(Instruction *root, Value *clone,
+                                BasicBlock *bb) {
+  Type *ty = root->getType();
+  if (!ty->isIntOrIntVectorTy() || ty->getScalarSizeInBits() == 1)
+    return clone;
 
-  return s(s, current, target, visited, blocks);
+  if (!DB) {
+    if (!AC)
+      AC = make_unique<AssumptionCache>(f);
+    DB = make_unique<DemandedBits>(f, *AC, DT);
+  }
+  APInt demanded = DB->getDemandedBits(root);
+  // a dead root is left to the cut as it is
+  if (demanded.isAllOnes() || demanded.isZero())
+    return clone;
+
+  debug(mctx) << "[slicer] demanded bits of the root: "
+              << toString(demanded, 16, false) << "\n";
+  return BinaryOperator::CreateAnd(clone, ConstantInt::get(ty, demanded),
+                                   DEMANDED, bb);
 }
 
-namespace minotaur {
+bool SliceCache::isSimplified(Loop *L) {
+  auto [it, inserted] = simplified.try_emplace(L, false);
+  if (inserted)
+    it->second = L->isLoopSimplifyForm();
+  return it->second;
+}
+
+void SliceCache::numberBlocks() {
+  if (!rpo.empty())
+    return;
+  ReversePostOrderTraversal<Function*> RPOT(&f);
+  for (BasicBlock *bb : RPOT) {
+    number[bb] = rpo.size();
+    rpo.push_back(bb);
+  }
+}
+
+bool SliceCache::isBackEdge(BasicBlock *from, BasicBlock *to) {
+  numberBlocks();
+  auto fi = number.find(from), ti = number.find(to);
+  if (fi == number.end() || ti == number.end())
+    return true;
+  return ti->second <= fi->second;
+}
+
+// the blocks on the paths from `to` down to `from` are the ones that are
+// reverse-reachable from `from` without leaving the region dominated by `to`,
+// and reachable from `to` inside that region. only edges that go forward in
+// reverse post-order are followed, so the region is a DAG: back edges are
+// untied by the slicer anyway. a single sweep in reverse post-order then
+// computes the reachability from `to` and the length of the longest path.
+const optional<set<BasicBlock*>> &
+SliceCache::getPath(BasicBlock *from, BasicBlock *to) {
+  auto [it, inserted] = paths.try_emplace({from, to});
+  if (!inserted)
+    return it->second;
+
+  numberBlocks();
+  auto fi = number.find(from), ti = number.find(to);
+  if (fi == number.end() || ti == number.end()) {
+    it->second = set<BasicBlock*>();
+    return it->second;
+  }
+  unsigned src = fi->second, dst = ti->second;
+
+  BitVector bwd(rpo.size());
+  SmallVector<unsigned, 16> worklist = { src };
+  bwd.set(src);
+  while (!worklist.empty()) {
+    unsigned b = worklist.pop_back_val();
+    if (b == dst)
+      continue;
+    for (BasicBlock *pred : predecessors(rpo[b])) {
+      auto pi = number.find(pred);
+      if (pi == number.end() || pi->second >= b || bwd.test(pi->second))
+        continue;
+      if (!DT.dominates(to, pred))
+        continue;
+      bwd.set(pi->second);
+      worklist.push_back(pi->second);
+    }
+  }
+
+  // `to` is not on any path, nothing needs to be harvested
+  if (!bwd.test(dst)) {
+    it->second = set<BasicBlock*>();
+    return it->second;
+  }
+
+  // blocks dominated by `to` come after it in reverse post-order
+  BitVector fwd(rpo.size());
+  vector<unsigned> dist(src - dst + 1, 0);
+  fwd.set(dst);
+  dist[0] = 1;
+  for (unsigned b = dst + 1; b <= src; ++b) {
+    if (!bwd.test(b))
+      continue;
+    for (BasicBlock *pred : predecessors(rpo[b])) {
+      auto pi = number.find(pred);
+      if (pi == number.end() || pi->second >= b || !fwd.test(pi->second))
+        continue;
+      fwd.set(b);
+      dist[b - dst] = max(dist[b - dst], dist[pi->second - dst] + 1);
+    }
+  }
+
+  if (dist[src - dst] > MAX_PATH_BLOCKS) {
+    debug(mctx) << "[slicer] block too distant from root, skipping\n";
+    return it->second;
+  }
+
+  set<BasicBlock*> blocks;
+  for (unsigned b : fwd.set_bits())
+    blocks.insert(rpo[b]);
+  it->second = std::move(blocks);
+  return it->second;
+}
 
 //  * if a external value is outside the loop, and it does not dominates v,
 //    do not extract it
 optional<pair<reference_wrapper<Function>, Instruction*>>
 Slice::extractExpr(Value &v) {
-  debug() << "[slicer] slicing value " << v << ">>>\n";
+  assert(isa<Instruction>(&v) && "Expr to be extracted must be a Instruction");
+  return extractExprs({cast<Instruction>(&v)});
+}
 
-  Type *vsty = v.getType()->getScalarType();
+optional<pair<reference_wrapper<Function>, Instruction*>>
+Slice::extractExprs(ArrayRef<Instruction*> roots) {
+  for (auto *r : roots)
+    debug(mctx) << "[slicer] slicing value " << *r << ">>>\n";
+
+  Type *vsty = roots[0]->getType()->getScalarType();
   if (isUnsupportedTy(vsty)) {
-    debug() << "[slicer] unsupported type " << *vsty << "\n";
+    debug(mctx) << "[slicer] unsupported type " << *vsty << "\n";
     return nullopt;
   }
 
-  assert(isa<Instruction>(&v) && "Expr to be extracted must be a Instruction");
-  Instruction *vi = cast<Instruction>(&v);
+  Instruction *vi = roots[0];
   BasicBlock *vbb = vi->getParent();
 
+  if (!isPowerOf2_32(roots.size())) {
+    debug(mctx) << "[slicer] roots cannot be concatenated pairwise\n";
+    return nullopt;
+  }
+  for (auto *r : roots) {
+    if (r->getType() != vi->getType() || r->getParent() != vbb) {
+      debug(mctx) << "[slicer] roots differ in type or block, skipping\n";
+      return nullopt;
+    }
+  }
+
   Loop *loopv = LI.getLoopFor(vbb);
   if (loopv) {
-    debug() << "[slicer] value is in " << *loopv;
+    debug(mctx) << "[slicer] value is in " << *loopv;
 
-    if (!loopv->isLoopSimplifyForm()) {
-      debug() << "[slicer] loop is not in simplified form, skipping\n";
+    if (!cache.isSimplified(loopv)) {
+      debug(mctx) << "[slicer] loop is not in simplified form, skipping\n";
       return nullopt;
     }
   }
@@ -121,7 +314,8 @@ Slice::extractExpr(Value &v) {
   ValueToValueMapTy vmap;
   set<Instruction*> insts;
 
-  worklist.push({&v, 0});
+  for (auto *r : roots)
+    worklist.push({r, 0});
 
   // pass 1;
   // + duplicate instructions, leave the operands untouched
@@ -133,7 +327,7 @@ Slice::extractExpr(Value &v) {
     auto &[w, depth] = worklist.front();
     worklist.pop();
 
-    if (depth >= config::slicer_max_depth)
+    if (depth >= mctx.slicer_max_depth)
       continue;
 
     if (!visited.insert(w).second)
@@ -147,36 +341,28 @@ Slice::extractExpr(Value &v) {
       if (loopi != loopv)
         continue;
 
-      if (loopi && !loopi->isLoopSimplifyForm()) {
-        debug() << "[slicer] loop is not in simplified form, skipping\n";
+      if (loopi && !cache.isSimplified(loopi)) {
+        debug(mctx) << "[slicer] loop is not in simplified form, skipping\n";
         continue;
       }
 
-      auto ops = i->operands();
+      auto &N = cache.getNode(i);
+      if (!N.harvestable) {
+        debug(mctx) << "[slicer] " << N.reason << "\n";
+        continue;
+      }
 
-      // filter unknown operation by instruction
       if (CallInst *call = dyn_cast<CallInst>(i)) {
         auto callee = call->getCalledFunction();
-        if (!callee) {
-          debug() << "[slicer] unknown callee \n";
-          continue;
-        }
-        if (!callee->isIntrinsic()) {
-          debug() << "[slicer] non-intrinsic call: "
-                  << callee->getName() << "\n";
-          continue;
-        }
-
         FunctionCallee intrindecl =
             m->getOrInsertFunction(callee->getName(), callee->getFunctionType(),
                                    callee->getAttributes());
 
         vmap[callee] = intrindecl.getCallee();
-        ops = call->args();
       } else if (auto phi = dyn_cast<PHINode>(i)) {
         bool phiHasUnknownIncome = false;
         if (ibb != vbb) {
-          debug() << "[slicer] phi node is not in the same block as the value\n";
+          debug(mctx) << "[slicer] phi node is not in the same block as the value\n";
           phiHasUnknownIncome = true;
         } else {
           unsigned incomes = phi->getNumIncomingValues();
@@ -195,43 +381,11 @@ Slice::extractExpr(Value &v) {
         }
         // if a phi node has unknown income, do not harvest
         if (phiHasUnknownIncome) {
-          debug() << "[slicer]" << *phi << " has external or constant income\n";
+          debug(mctx) << "[slicer]" << *phi << " has external or constant income\n";
           continue;
         }
       }
 
-      // filter unknown operation by operand type
-      bool haveUnknownOperand = false;
-      for (auto &op : ops) {
-        if (isa<GlobalValue>(op)) {
-          debug() << "[slicer] found instruction that uses GlobalValue\n";
-          haveUnknownOperand = true;
-          break;
-        }
-        if (isa<ConstantExpr>(op)) {
-          debug() << "[slicer] found instruction that uses ConstantExpr\n";
-          haveUnknownOperand = true;
-          break;
-        }
-        // give up <i31 34, i31 ptrtoint (ptr @external_global to i31)>
-        if (auto c = dyn_cast<Constant>(op)) {
-          if (c->containsConstantExpression()) {
-            haveUnknownOperand = true;
-            break;
-          }
-        }
-        auto op_ty = op->getType();
-        if (isUnsupportedTy(op_ty)) {
-          debug() << "[slicer] found instruction with operands with type "
-                  << *op_ty <<"\n";
-          haveUnknownOperand = true;
-          break;
-        }
-      }
-      if (haveUnknownOperand) {
-        continue;
-      }
-
       insts.insert(i);
 
       for (auto &op : i->operands()) {
@@ -246,9 +400,15 @@ Slice::extractExpr(Value &v) {
 
   // if no instructions satisfied the criteria of cloning, return null.
   if (insts.empty()) {
-    debug() << "[slicer] no eligible instruction can be harvested, skipping\n";
+    debug(mctx) << "[slicer] no eligible instruction can be harvested, skipping\n";
     return nullopt;
   }
+  for (auto *r : roots) {
+    if (!insts.count(r)) {
+      debug(mctx) << "[slicer] root cannot be harvested, skipping\n";
+      return nullopt;
+    }
+  }
 
   set<BasicBlock*> blocks;
   blocks.insert(vbb);
@@ -309,21 +469,22 @@ Slice::extractExpr(Value &v) {
 
   for(auto &[from, tos] : bb_deps) {
     for (auto to : tos) {
-      debug() << "[slicer] walking from " << from->getName() << " to "
+      debug(mctx) << "[slicer] walking from " << from->getName() << " to "
               << to->getName() << "\n";
-      if (!walk(from, to, blocks, DT)) {
+      auto &path = cache.getPath(from, to);
+      if (!path.has_value())
         return nullopt;
-      }
+      blocks.insert(path->begin(), path->end());
     }
   }
 
-  debug () << "[slicer] " << insts.size() << " instructions are harvested\n";
+  debug(mctx) << "[slicer] " << insts.size() << " instructions are harvested\n";
   for (auto &i : insts) {
-    debug() << "[slicer] harvested instruction " << *i << "\n";
+    debug(mctx) << "[slicer] harvested instruction " << *i << "\n";
   }
 
   for (auto &bb : blocks) {
-    debug () << "[slicer] harvested block " << bb->getName() << "\n";
+    debug(mctx) << "[slicer] harvested block " << bb->getName() << "\n";
   }
 
 
@@ -361,6 +522,9 @@ Slice::extractExpr(Value &v) {
 
   set<BasicBlock *> cloned_blocks;
   map<BasicBlock *, BasicBlock *> bmap;
+  // the instruction the cut is solved for, and the value it returns
+  Instruction *root = nullptr;
+  Value *retv = nullptr;
   {
     // pass 3.1.1;
     // + duplicate BB;
@@ -427,8 +591,19 @@ Slice::extractExpr(Value &v) {
     }
 
     // create ret
-    ReturnInst *ret = ReturnInst::Create(ctx, vmap[&v]);
     BasicBlock *bb = bmap.at(vbb);
+    SmallVector<Value*, 4> rets;
+    for (auto *r : roots)
+      rets.push_back(cache.demandedRoot(r, vmap[r], bb));
+    if (roots.size() == 1) {
+      root = cast<Instruction>(vmap[vi]);
+      retv = rets[0];
+    } else {
+      IRBuilder<> B(bb);
+      retv = concat_roots(B, rets);
+      root = cast<Instruction>(retv);
+    }
+    ReturnInst *ret = ReturnInst::Create(ctx, retv);
     ret->insertInto(bb, bb->end());
   }
 
@@ -469,8 +644,10 @@ Slice::extractExpr(Value &v) {
   }
 
   // create function
-  Function *F = Function::Create(FunctionType::get(v.getType(), argTys, false),
+  Function *F = Function::Create(FunctionType::get(retv->getType(), argTys,
+                                                   false),
                                  GlobalValue::ExternalLinkage, "cut", *m);
+  copy_target_attributes(f, *F);
 
   for (auto &arg : F->args()) {
     string name;
@@ -552,11 +729,10 @@ Slice::extractExpr(Value &v) {
     report_fatal_error("[slicer] illformed function generated, terminating\n");
   }
 
-  debug()<< *F << "\n" << "<<< end of %" << v.getName() << " <<<\n";
+  debug(mctx)<< *F << "\n" << "<<< end of %" << vi->getName() << " <<<\n";
 
 
-  return pair<reference_wrapper<Function>, Instruction*>(*F,
-    cast<Instruction>(vmap[&v]));
+  return pair<reference_wrapper<Function>, Instruction*>(*F, root);
 }
 
 } // namespace minotaur
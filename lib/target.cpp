@@ -0,0 +1,162 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "target.h"
+#include "type.h"
+
+#include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/TargetParser/X86TargetParser.h"
+
+#include <array>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace llvm;
+
+namespace minotaur {
+
+using Requirements = SmallVector<string, 3>;
+
+// the features an intrinsic needs, from its name: x86_<isa>_<op>. the avx512
+// forms of byte and word operations need avx512bw, and those narrower than
+// 512 bits need avx512vl.
+static Requirements required(StringRef Name, type Op0, type Ret) {
+  StringRef ISA = Name;
+  ISA.consume_front("x86_");
+  ISA = ISA.split('_').first;
+  if (ISA == "avx512") {
+    Requirements R = { "avx512f" };
+    if (Op0.getBits() <= 16 || Name.contains("pack"))
+      R.push_back("avx512bw");
+    if (Ret.getWidth() < 512)
+      R.push_back("avx512vl");
+    return R;
+  }
+  if (ISA == "sse41")
+    return { "sse4.1" };
+  if (ISA == "sse42")
+    return { "sse4.2" };
+  return { ISA.str() };
+}
+
+static const vector<Requirements> &binopRequirements() {
+  static const vector<Requirements> table = [] {
+    static constexpr array<string_view, IR::X86IntrinBinOp::numOfX86Intrinsics>
+      Names = {
+#define PROCESS(NAME,A,B,C,D,E,F) #NAME,
+#include "ir/intrinsics_binop.h"
+#undef PROCESS
+    };
+    vector<Requirements> t;
+    for (unsigned K = 0; K < Names.size(); ++K) {
+      auto op = static_cast<IR::X86IntrinBinOp::Op>(K);
+      t.push_back(required(Names[K], getIntrinsicOp0Ty(op),
+                           getIntrinsicRetTy(op)));
+    }
+    return t;
+  }();
+  return table;
+}
+
+static const vector<Requirements> &teropRequirements() {
+  static const vector<Requirements> table = [] {
+    static constexpr array<string_view, IR::X86IntrinTerOp::numOfX86Intrinsics>
+      Names = {
+#define PROCESS(NAME,A,B,C,D,E,F,G,H) #NAME,
+#include "ir/intrinsics_terop.h"
+#undef PROCESS
+    };
+    vector<Requirements> t;
+    for (unsigned K = 0; K < Names.size(); ++K) {
+      auto op = static_cast<IR::X86IntrinTerOp::Op>(K);
+      t.push_back(required(Names[K], getIntrinsicOp0Ty(op),
+                           getIntrinsicRetTy(op)));
+    }
+    return t;
+  }();
+  return table;
+}
+
+// every feature some intrinsic depends on
+static const set<string> &gatingFeatures() {
+  static const set<string> features = [] {
+    set<string> s;
+    for (auto &R : binopRequirements())
+      s.insert(R.begin(), R.end());
+    for (auto &R : teropRequirements())
+      s.insert(R.begin(), R.end());
+    return s;
+  }();
+  return features;
+}
+
+static void setFeature(StringMap<bool> &Map, StringRef Feature, bool Enabled) {
+  Map[Feature] = Enabled;
+  X86::updateImpliedFeatures(Feature, Enabled, Map);
+}
+
+TargetFeatures TargetFeatures::get(const Function &F) {
+  Attribute CPU = F.getFnAttribute("target-cpu");
+  Attribute Features = F.getFnAttribute("target-features");
+  if (!CPU.isValid() && !Features.isValid())
+    return get("", "+avx2");
+  return get(CPU.isValid() ? CPU.getValueAsString() : "",
+             Features.isValid() ? Features.getValueAsString() : "");
+}
+
+TargetFeatures TargetFeatures::get(StringRef CPU, StringRef Features) {
+  StringMap<bool> Map;
+  if (!CPU.empty()) {
+    SmallVector<StringRef, 64> CPUFeatures;
+    X86::getFeaturesForCPU(CPU, CPUFeatures);
+    for (StringRef Feature : CPUFeatures)
+      setFeature(Map, Feature, true);
+  }
+
+  SmallVector<StringRef, 64> Flags;
+  Features.split(Flags, ',', -1, false);
+  for (StringRef Flag : Flags) {
+    if (Flag.size() < 2 || (Flag[0] != '+' && Flag[0] != '-'))
+      continue;
+    setFeature(Map, Flag.drop_front(), Flag[0] == '+');
+  }
+
+  TargetFeatures TF;
+  for (auto &E : Map)
+    if (E.getValue())
+      TF.enabled.insert(E.getKey().str());
+  return TF;
+}
+
+bool TargetFeatures::has(StringRef Feature) const {
+  return enabled.count(Feature.str());
+}
+
+bool TargetFeatures::supports(IR::X86IntrinBinOp::Op op) const {
+  for (auto &Feature : binopRequirements()[op])
+    if (!has(Feature))
+      return false;
+  return true;
+}
+
+bool TargetFeatures::supports(IR::X86IntrinTerOp::Op op) const {
+  for (auto &Feature : teropRequirements()[op])
+    if (!has(Feature))
+      return false;
+  return true;
+}
+
+string TargetFeatures::key() const {
+  string str;
+  for (auto &Feature : enabled) {
+    if (!gatingFeatures().count(Feature))
+      continue;
+    if (!str.empty())
+      str += ",";
+    str += Feature;
+  }
+  return str;
+}
+
+} // namespace minotaur
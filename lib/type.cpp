@@ -9,7 +9,9 @@
 #include "llvm/IR/Type.h"
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ErrorHandling.h"
+#include <map>
 #include <string>
+#include <vector>
 
 using namespace std;
 using namespace llvm;
@@ -169,18 +171,70 @@ type getIntrinsicRetTy(IR::X86IntrinBinOp::Op op) {
                                    IR::X86IntrinBinOp::shape_ret[op].second);
 }
 
-vector<type> getIntegerVectorTypes(type ty) {
+type getIntrinsicOp0Ty(IR::X86IntrinTerOp::Op op) {
+  return type::IntegerVectorizable(IR::X86IntrinTerOp::shape_op0[op].first,
+                                   IR::X86IntrinTerOp::shape_op0[op].second);
+}
+
+type getIntrinsicOp1Ty(IR::X86IntrinTerOp::Op op) {
+  return type::IntegerVectorizable(IR::X86IntrinTerOp::shape_op1[op].first,
+                                   IR::X86IntrinTerOp::shape_op1[op].second);
+}
+
+type getIntrinsicOp2Ty(IR::X86IntrinTerOp::Op op) {
+  return type::IntegerVectorizable(IR::X86IntrinTerOp::shape_op2[op].first,
+                                   IR::X86IntrinTerOp::shape_op2[op].second);
+}
+
+type getIntrinsicRetTy(IR::X86IntrinTerOp::Op op) {
+  return type::IntegerVectorizable(IR::X86IntrinTerOp::shape_ret[op].first,
+                                   IR::X86IntrinTerOp::shape_ret[op].second);
+}
+
+ArrayRef<IR::X86IntrinBinOp::Op> getIntrinsicsByRetWidth(unsigned width) {
+  static const map<unsigned, vector<IR::X86IntrinBinOp::Op>> table = [] {
+    map<unsigned, vector<IR::X86IntrinBinOp::Op>> t;
+    for (unsigned K = 0; K < IR::X86IntrinBinOp::numOfX86Intrinsics; ++K) {
+      auto op = static_cast<IR::X86IntrinBinOp::Op>(K);
+      t[getIntrinsicRetTy(op).getWidth()].push_back(op);
+    }
+    return t;
+  }();
+
+  auto it = table.find(width);
+  if (it == table.end())
+    return {};
+  return it->second;
+}
+
+ArrayRef<IR::X86IntrinTerOp::Op> getTerIntrinsicsByRetWidth(unsigned width) {
+  static const map<unsigned, vector<IR::X86IntrinTerOp::Op>> table = [] {
+    map<unsigned, vector<IR::X86IntrinTerOp::Op>> t;
+    for (unsigned K = 0; K < IR::X86IntrinTerOp::numOfX86Intrinsics; ++K) {
+      auto op = static_cast<IR::X86IntrinTerOp::Op>(K);
+      t[getIntrinsicRetTy(op).getWidth()].push_back(op);
+    }
+    return t;
+  }();
+
+  auto it = table.find(width);
+  if (it == table.end())
+    return {};
+  return it->second;
+}
+
+WorkTypes getIntegerVectorTypes(type ty) {
   unsigned width = ty.getWidth();
 
   if (width % 8 != 0) {
     return { ty };
   }
 
-  vector<unsigned> bits{64, 32, 16, 8};
-  vector<type> types;
-  for (unsigned i = 0 ; i < 4 ; ++ i) {
-    if (width % bits[i] == 0 && width >= bits[i]) {
-      types.push_back(type::IntegerVectorizable(width/bits[i], bits[i]));
+  static constexpr unsigned bits[] = {64, 32, 16, 8};
+  WorkTypes types;
+  for (unsigned b : bits) {
+    if (width % b == 0 && width >= b) {
+      types.push_back(type::IntegerVectorizable(width/b, b));
     }
   }
   return types;
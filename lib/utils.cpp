@@ -2,11 +2,16 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 #include "utils.h"
 
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/Transforms/Scalar/DCE.h"
 #include "llvm/Passes/PassBuilder.h"
 
 #include "hiredis.h"
 
+#include <numeric>
+#include <sys/resource.h>
 #include <unordered_set>
 
 using namespace std;
@@ -25,6 +30,100 @@ void eliminate_dead_code(Function &F) {
   FPM.run(F, FAM);
 }
 
+void copy_target_attributes(const Function &From, Function &To) {
+  for (StringRef Kind : {"target-cpu", "target-features"})
+    if (From.hasFnAttribute(Kind))
+      To.addFnAttr(From.getFnAttribute(Kind));
+}
+
+FastMathFlags common_fast_math_flags(const Function &F) {
+  FastMathFlags FMF;
+  bool First = true;
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      // phis and selects only forward values
+      if (!isa<FPMathOperator>(&I) || isa<PHINode>(&I) || isa<SelectInst>(&I))
+        continue;
+      if (First)
+        FMF = I.getFastMathFlags();
+      else
+        FMF &= I.getFastMathFlags();
+      First = false;
+    }
+  }
+  return FMF;
+}
+
+static constexpr const char *ROOTS = "__roots";
+
+Value *concat_roots(IRBuilderBase &B, ArrayRef<Value*> Roots) {
+  assert(isPowerOf2_32(Roots.size()) && "roots are concatenated pairwise");
+  Type *Ty = Roots[0]->getType();
+  if (!Ty->isVectorTy()) {
+    Value *V = PoisonValue::get(FixedVectorType::get(Ty, Roots.size()));
+    for (unsigned i = 0; i < Roots.size(); ++i)
+      V = B.CreateInsertElement(V, Roots[i], i, ROOTS);
+    return V;
+  }
+
+  SmallVector<Value*, 4> Parts(Roots.begin(), Roots.end());
+  while (Parts.size() > 1) {
+    SmallVector<Value*, 4> Next;
+    for (unsigned i = 0; i < Parts.size(); i += 2) {
+      unsigned N = cast<FixedVectorType>(Parts[i]->getType())->getNumElements();
+      SmallVector<int, 16> Mask(2 * N);
+      std::iota(Mask.begin(), Mask.end(), 0);
+      Next.push_back(B.CreateShuffleVector(Parts[i], Parts[i + 1], Mask, ROOTS));
+    }
+    Parts = std::move(Next);
+  }
+  return Parts[0];
+}
+
+SmallVector<Value*, 4> cut_roots(Value *V) {
+  auto *I = dyn_cast<Instruction>(V);
+  // a root masked to its demanded bits, see SliceCache::demandedRoot
+  if (I && I->getOpcode() == Instruction::And &&
+      I->getName().starts_with(DEMANDED))
+    return { I->getOperand(0) };
+  if (!I || !I->getName().starts_with(ROOTS))
+    return { V };
+
+  SmallVector<Value*, 4> Roots;
+  if (auto *IE = dyn_cast<InsertElementInst>(I)) {
+    if (!isa<PoisonValue>(IE->getOperand(0)))
+      Roots = cut_roots(IE->getOperand(0));
+    Roots.push_back(IE->getOperand(1));
+  } else {
+    auto *SV = cast<ShuffleVectorInst>(I);
+    Roots = cut_roots(SV->getOperand(0));
+    auto R = cut_roots(SV->getOperand(1));
+    Roots.append(R.begin(), R.end());
+  }
+  return Roots;
+}
+
+Value *extract_root(IRBuilderBase &B, Value *V, Type *Ty, unsigned i) {
+  auto *VTy = dyn_cast<FixedVectorType>(Ty);
+  if (!VTy)
+    return B.CreateExtractElement(V, i);
+  unsigned N = VTy->getNumElements();
+  SmallVector<int, 16> Mask(N);
+  std::iota(Mask.begin(), Mask.end(), i * N);
+  return B.CreateShuffleVector(V, Mask);
+}
+
+size_t peak_rss() {
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage))
+    return 0;
+#ifdef __APPLE__
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
 bool hGet(const char* s, unsigned sz, string &Value, redisContext *c) {
   redisReply *reply = (redisReply *)redisCommand(c, "HGET %b rewrite", s, sz);
   if (!reply || c->err) {
@@ -34,7 +133,7 @@ bool hGet(const char* s, unsigned sz, string &Value, redisContext *c) {
     freeReplyObject(reply);
     return false;
   } else if (reply->type == REDIS_REPLY_STRING) {
-    Value = reply->str;
+    Value.assign(reply->str, reply->len);
     freeReplyObject(reply);
     return true;
   } else {
@@ -50,8 +149,8 @@ void hSetRewrite(const char *k, unsigned sz_k,
                  redisContext *c,
                  unsigned costAfter, unsigned costBefore, StringRef FnName) {
   redisReply *reply = (redisReply *)redisCommand(c,
-    "HSET %b rewrite %s  costafter %s costbefore %s timestamp %s fn %s",
-    k, sz_k, rewrite.data(),
+    "HSET %b rewrite %b costafter %s costbefore %s timestamp %s fn %s",
+    k, sz_k, rewrite.data(), rewrite.size(),
     to_string(costAfter).c_str(), to_string(costBefore).c_str(),
     to_string((unsigned long)time(NULL)).c_str(), FnName.data());
   if (!reply || c->err)
@@ -89,12 +188,52 @@ void hSetNoSolution(const char *k, unsigned sz_k,
   freeReplyObject(reply);
 }
 
-void removeUnusedDecls(unordered_set<Function *> IntrinsicDecls) {
-  for (auto Intr : IntrinsicDecls) {
-    if (Intr->isDeclaration() && Intr->use_empty()) {
-      Intr->eraseFromParent();
+// mark a cut as waiting for synthesis and queue it for the offline workers,
+// returns false if the cut is already known to the cache. with force, an
+// entry already in the cache is replaced, e.g. one that does not decode
+bool hSetPending(const char *k, unsigned sz_k,
+                 redisContext *c,
+                 StringRef FnName, bool force) {
+  redisReply *reply = (redisReply *)redisCommand(c,
+    force ? "HSET %b rewrite <pending>" : "HSETNX %b rewrite <pending>",
+    k, sz_k);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  if (reply->type != REDIS_REPLY_INTEGER) {
+    report_fatal_error((StringRef)
+      "Redis protocol error for cache fill, didn't expect reply type " +
+      to_string(reply->type));
+  }
+  // HSET counts the new fields only, a replaced rewrite is inserted too
+  bool inserted = force || reply->integer == 1;
+  freeReplyObject(reply);
+
+  if (inserted) {
+    reply = (redisReply *)redisCommand(c,
+      "HSET %b timestamp %s fn %s",
+      k, sz_k, to_string((unsigned long)time(NULL)).c_str(), FnName.data());
+    if (!reply || c->err)
+      report_fatal_error((StringRef)"Redis error: " + c->errstr);
+    freeReplyObject(reply);
+
+    reply = (redisReply *)redisCommand(c, "LPUSH %s %b",
+                                       PENDING_QUEUE, k, sz_k);
+    if (!reply || c->err)
+      report_fatal_error((StringRef)"Redis error: " + c->errstr);
+    if (reply->type != REDIS_REPLY_INTEGER) {
+      report_fatal_error((StringRef)
+        "Redis protocol error for queue push, didn't expect reply type " +
+        to_string(reply->type));
     }
+    freeReplyObject(reply);
   }
+
+  // static profile
+  reply = (redisReply *)redisCommand(c, "HINCRBY %b profile 1", k, sz_k);
+  if (!reply || c->err)
+    report_fatal_error((StringRef)"Redis error: " + c->errstr);
+  freeReplyObject(reply);
+  return inserted;
 }
 
 }
\ No newline at end of file
@@ -6,6 +6,7 @@
 #include "expr.h"
 #include "slice.h"
 #include "removal-slice.h"
+#include "serialize.h"
 #include "util/random.h"
 #include "utils.h"
 #include "parse.h"
@@ -24,6 +25,7 @@
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/MemoryDependenceAnalysis.h"
 #include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Dominators.h"
@@ -32,6 +34,7 @@
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/Pass.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Passes/PassPlugin.h"
@@ -40,6 +43,7 @@
 #include "llvm/Support/Error.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Transforms/Utils/Cloning.h"
 #include "llvm/Transforms/Utils/LoopUtils.h"
@@ -47,12 +51,15 @@
 
 #include "hiredis.h"
 
+#include <algorithm>
+#include <atomic>
 #include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <random>
 #include <unordered_map>
 #include <sstream>
+#include <thread>
 #include <utility>
 
 using namespace std;
@@ -73,11 +80,29 @@ llvm::cl::opt<unsigned> slice_to(
     llvm::cl::desc("minotaur: timeout per slice"),
     llvm::cl::init(300), llvm::cl::value_desc("s"));
 
+llvm::cl::opt<unsigned> max_inputs(
+    "minotaur-max-inputs",
+    llvm::cl::desc("minotaur: number of ranked inputs the enumerator starts "
+                   "with (0 = all)"),
+    llvm::cl::init(8));
+
+llvm::cl::opt<unsigned> max_tier(
+    "minotaur-max-tier",
+    llvm::cl::desc("minotaur: costliest tier of sketches to try, 0 = nops, "
+                   "1 = single operations, 2 = constants to synthesize, "
+                   "3 = everything (default)"),
+    llvm::cl::init(3));
+
 llvm::cl::opt<bool> smt_verbose(
     "minotaur-smt-verbose",
     llvm::cl::desc("minotaur: SMT verbose mode"),
     llvm::cl::init(false));
 
+llvm::cl::opt<bool> show_stats(
+    "minotaur-show-stats",
+    llvm::cl::desc("minotaur: print the peak resident set size when done"),
+    llvm::cl::init(false));
+
 llvm::cl::opt<bool> enable_caching(
     "minotaur-enable-caching",
     llvm::cl::desc("minotaur: enable result caching"),
@@ -120,7 +145,8 @@ llvm::cl::opt<unsigned> redis_port(
 
 llvm::cl::opt<bool> no_infer(
     "minotaur-no-infer",
-    llvm::cl::desc("minotaur: do not run synthesizer"),
+    llvm::cl::desc("minotaur: do not run synthesizer, queue cache misses "
+                   "for offline synthesis"),
     llvm::cl::init(false));
 
 llvm::cl::opt<bool> no_slice(
@@ -128,11 +154,43 @@ llvm::cl::opt<bool> no_slice(
     llvm::cl::desc("minotaur: do not run slicer"),
     llvm::cl::init(false));
 
+enum class SlicerKind { Forward, Removal };
+
+llvm::cl::opt<SlicerKind> slicer_kind(
+    "minotaur-slicer",
+    llvm::cl::desc("minotaur: slicer used to extract cuts"),
+    llvm::cl::values(
+      clEnumValN(SlicerKind::Forward, "forward",
+                 "grow the cut from the root (default)"),
+      clEnumValN(SlicerKind::Removal, "removal",
+                 "copy the region of the root, remove what it does not use")),
+    llvm::cl::init(SlicerKind::Forward));
+
+llvm::cl::opt<bool> first_solution(
+    "minotaur-first-solution",
+    llvm::cl::desc("minotaur: apply the first rewrite found, and queue the cut "
+                   "for the offline workers to search for a cheaper one"),
+    llvm::cl::init(false));
+
+llvm::cl::opt<bool> multi_root(
+    "minotaur-multi-root",
+    llvm::cl::desc("minotaur: synthesize pairs of related values of a block "
+                   "together before the single values, function pass only"),
+    llvm::cl::init(false));
+
 llvm::cl::opt<bool> force_infer(
     "minotaur-force-infer",
     llvm::cl::desc("minotaur: force infer even if cache hits"),
     llvm::cl::init(false));
 
+llvm::cl::opt<unsigned> num_threads(
+    "minotaur-threads",
+    llvm::cl::desc("minotaur: synthesize all slices of a module with this "
+                   "many threads before rewriting (0 = per function in the "
+                   "default pipelines, one thread per core for an explicit "
+                   "minotaur-module)"),
+    llvm::cl::init(0));
+
 llvm::cl::opt<string> report_dir("minotaur-report-dir",
   llvm::cl::desc("Save report to disk"), llvm::cl::value_desc("directory"));
 
@@ -148,17 +206,80 @@ static bool dom_check(llvm::Value *V, DominatorTree &DT, llvm::Use &U) {
 }
 
 struct debug {
+const MinotaurContext &mctx;
+debug(const MinotaurContext &mctx) : mctx(mctx) {}
+
 template<class T>
 debug &operator<<(const T &s)
 {
-  if (debug_enumerator || debug_slicer || debug_tv || debug_codegen)
-    minotaur::config::dbg()<<s;
+  if (mctx.debug_enumerator || mctx.debug_slicer || mctx.debug_tv ||
+      mctx.debug_codegen)
+    mctx.dbg()<<s;
   return *this;
 }
 };
 
+static unique_ptr<Slicer> make_slicer(SliceCache &SC) {
+  if (slicer_kind == SlicerKind::Removal)
+    return make_unique<RemovalSlice>(SC);
+  return make_unique<minotaur::Slice>(SC);
+}
+
+// result of looking up a cut in the cache
+enum class CacheState { Miss, Hit, NoSolution, Pending };
+
+static CacheState
+lookup_cache(const string &bytecode, redisContext *ctx, string &rewrite) {
+  if (!minotaur::hGet(bytecode.c_str(), bytecode.size(), rewrite, ctx))
+    return CacheState::Miss;
+  if (rewrite == "<no-sol>")
+    return CacheState::NoSolution;
+  if (rewrite == "<pending>")
+    return CacheState::Pending;
+  return CacheState::Hit;
+}
+
+// the cheapest rewrite of the slice, or the first one found in
+// first-solution mode
+static optional<Rewrite>
+search(Function &F, Instruction *I, Enumerator &EN, const MinotaurContext &MC) {
+  optional<Rewrite> Best;
+  auto Keep = [&Best, &MC](const Rewrite &R, const SolveStats&) {
+    if (!Best || R.CostAfter < Best->CostAfter)
+      Best = R;
+    return !MC.return_first_solution;
+  };
+  auto Stats = EN.solve(F, I, Keep);
+  debug(MC) << "[online] " << Stats.generated << " candidates, "
+            << Stats.queried << " queries, " << Stats.proven << " proven\n";
+  return Best;
+}
+
+// a rewrite from first-solution mode may not be the cheapest, the cut is
+// left pending for the offline workers instead of being cached
+static void cache_rewrite(const string &Key, redisContext *ctx,
+                          const Rewrite &R, const string &rewrite,
+                          StringRef FnName, const MinotaurContext &MC) {
+  if (MC.return_first_solution)
+    hSetPending(Key.c_str(), Key.size(), ctx, FnName);
+  else
+    hSetRewrite(Key.c_str(), Key.size(), "", 0,
+                rewrite, ctx, R.CostAfter, R.CostBefore, FnName);
+}
+
+// a search limited to the cheap tiers is not conclusive, the cut is left
+// pending for the offline workers to try the other tiers
+static void cache_no_solution(const string &Key, redisContext *ctx,
+                              StringRef FnName, const MinotaurContext &MC) {
+  if (MC.max_tier < NumTiers - 1)
+    hSetPending(Key.c_str(), Key.size(), ctx, FnName);
+  else
+    hSetNoSolution(Key.c_str(), Key.size(), ctx, FnName);
+}
+
 static optional<Rewrite>
-infer(Function &F, Instruction *I, redisContext *ctx, Enumerator &EN, parse::Parser &P) {
+infer(Function &F, Instruction *I, redisContext *ctx, Enumerator &EN,
+      parse::Parser &P, const MinotaurContext &MC) {
   string bytecode;
   llvm::raw_string_ostream bs(bytecode);
   //WriteBitcodeToFile(*F.getParent(), bs);
@@ -170,76 +291,147 @@ infer(Function &F, Instruction *I, redisContext *ctx, Enumerator &EN, parse::Par
   bool from_cache = false;
 
   // for caching, minotaur has three modes:
-  // 1. no_infer: do not run synthesizer
+  // 1. no_infer: do not run synthesizer, use cached solutions only, and mark
+  //    cache misses as pending for the offline workers
   // 2. force_infer: force synthesizer even if cache hits
   // 3. normal mode: run synthesizer if cache miss
 
-  // check cache only in normal mode
-  if (enable_caching && !force_infer && !no_infer) {
+  // check cache in normal mode and no_infer mode
+  if (enable_caching && !force_infer) {
     std::string rewrite;
 
-    if (minotaur::hGet(bytecode.c_str(), bytecode.size(), rewrite, ctx)) {
-      if (rewrite == "<no-sol>") {
-        debug() << "[online] cache matched, but no solution found in "
-                    "previous run, skipping function: "
+    switch (lookup_cache(bytecode, ctx, rewrite)) {
+    case CacheState::NoSolution:
+      debug(MC) << "[online] cache matched, but no solution found in "
+                  "previous run, skipping function: "
+              << F.getName() << "\n";
+      return nullopt;
+    case CacheState::Pending:
+      // in normal mode, a pending cut is treated as a cache miss
+      if (no_infer) {
+        debug(MC) << "[online] cache matched, but synthesis is still "
+                    "pending, skipping function: "
                 << F.getName() << "\n";
         return nullopt;
-      } else {
-        debug() << "[online] cache matched, using previous solution for "
-                    "function: "
-                << F.getName() << "\n";
-        RHSs = P.parse(F, rewrite);
-        if (RHSs.empty()) {
-          debug() << "[online] failed to parse cached solution\n";
-          return nullopt;
-        }
-        debug() << *RHSs[0].I << "\n";
-        from_cache = true;
       }
+      break;
+    case CacheState::Hit:
+      debug(MC) << "[online] cache matched, using previous solution for "
+                  "function: "
+              << F.getName() << "\n";
+      RHSs = P.parse(F, rewrite);
+      // an entry that does not decode, e.g. from an older encoding, is
+      // treated as a miss. it is replaced by a pending entry right away,
+      // which the synthesis below or the offline workers overwrite
+      if (RHSs.empty()) {
+        debug(MC) << "[online] failed to parse cached solution, treating it "
+                    "as a cache miss\n";
+        hSetPending(bytecode.c_str(), bytecode.size(), ctx, F.getName(),
+                    true);
+        break;
+      }
+      debug(MC) << *RHSs[0].I << "\n";
+      from_cache = true;
+      break;
+    case CacheState::Miss:
+      break;
     }
   }
 
 
-  if (no_infer) {
-  // in no_infer mode, we write no-sol and return
+  if (no_infer && !from_cache) {
+  // in no_infer mode, we queue the cut for offline synthesis and return
     if (enable_caching) {
-      hSetNoSolution(bytecode.c_str(), bytecode.size(), ctx, F.getName());
+      if (hSetPending(bytecode.c_str(), bytecode.size(), ctx, F.getName()))
+        debug(MC) << "[online] cache missed, cut is queued for synthesis\n";
     }
-    debug() << "[online] skipping synthesizer\n";
+    debug(MC) << "[online] skipping synthesizer\n";
     return nullopt;
   } else if (!from_cache) {
     // in force_infer mode, as from_cache is always false, we run synthesizer
     // in normal mode, we run synthesizer only when cache misses
-    debug() << "[online] working on function:\n" << F;
-    RHSs = EN.solve(F, I);
-    if (RHSs.empty()) {
+    debug(MC) << "[online] working on function:\n" << F;
+    auto Best = search(F, I, EN, MC);
+    if (!Best) {
       if (enable_caching)
-        hSetNoSolution(bytecode.c_str(), bytecode.size(), ctx, F.getName());
+        cache_no_solution(bytecode, ctx, F.getName(), MC);
       return nullopt;
     }
+    RHSs.push_back(*Best);
   }
 
   auto R = RHSs[0];
-  debug() << "[online] synthesized solution:\n" << *R.I << "\n";
+  debug(MC) << "[online] synthesized solution:\n" << *R.I << "\n";
 
   // write back to cache
   if (!from_cache && enable_caching) {
-    debug()<<"[online] caching solution\n";
-    string rewrite;
-    raw_string_ostream rs(rewrite);
-    R.I->print(rs);
-    rs.flush();
-    hSetRewrite(bytecode.c_str(), bytecode.size(),
-                "", 0,
-                rewrite, ctx, R.CostAfter, R.CostBefore, F.getName());
+    debug(MC)<<"[online] caching solution\n";
+    cache_rewrite(bytecode, ctx, R, serialize(R.I), F.getName(), MC);
   }
   return R;
 }
 
-static bool
-optimize_function(llvm::Function &F, LoopInfo &LI, DominatorTree &DT,
-                  TargetLibraryInfoWrapperPass &TLI) {
-  // set up debug output
+// materialize the rewrite after I and replace the uses of I it dominates.
+// the rewrite was verified with the fast-math flags of Cut, the slice of I
+static bool apply_rewrite(Instruction &I, Inst *R, ValueToValueMapTy &VMap,
+                          const Function &Cut, DominatorTree &DT,
+                          const MinotaurContext &MC) {
+  bool changed = false;
+  unordered_set<llvm::Function*> IntrinDecls;
+  Instruction *insertpt = I.getNextNode();
+  while(isa<PHINode>(insertpt)) {
+    insertpt = insertpt->getNextNode();
+  }
+
+  auto *V = LLVMGen(insertpt, IntrinDecls, MC, common_fast_math_flags(Cut))
+               .codeGen(R, VMap);
+  V = llvm::IRBuilder<>(insertpt).CreateBitCast(V, I.getType());
+
+  I.replaceUsesWithIf(V, [&changed, &V, &DT](Use &U) {
+    if(dom_check(V, DT, U)) {
+      changed = true;
+      return true;
+    }
+    return false;
+  });
+  return changed;
+}
+
+// materialize the rewrite of a cut of several roots after the last of them
+// and replace every root with its part. the rewrite is only profitable with
+// all the roots gone, so nothing changes unless every use of every root comes
+// after the last one
+static bool apply_roots(ArrayRef<Instruction*> Roots, Inst *R,
+                        ValueToValueMapTy &VMap, const Function &Cut,
+                        DominatorTree &DT, const MinotaurContext &MC) {
+  Instruction *Last = Roots.back();
+  for (auto *Root : Roots) {
+    for (auto &U : Root->uses()) {
+      if (!DT.dominates(Last, U)) {
+        debug(MC) << "[online] " << *Root << " is used before "
+                  << *Last << ", skipping\n";
+        return false;
+      }
+    }
+  }
+
+  unordered_set<llvm::Function*> IntrinDecls;
+  Instruction *insertpt = Last->getNextNode();
+  while(isa<PHINode>(insertpt)) {
+    insertpt = insertpt->getNextNode();
+  }
+
+  auto *V = LLVMGen(insertpt, IntrinDecls, MC, common_fast_math_flags(Cut))
+               .codeGen(R, VMap);
+  llvm::IRBuilder<> B(insertpt);
+  V = B.CreateBitCast(V, Cut.getReturnType());
+  for (unsigned i = 0; i < Roots.size(); ++i)
+    Roots[i]->replaceAllUsesWith(extract_root(B, V, Roots[i]->getType(), i));
+  return true;
+}
+
+// set up debug output, returns the stream to be released by close_report
+static raw_ostream *open_report() {
   raw_ostream *out_file = &errs();
   if (!report_dir.empty()) {
     try {
@@ -268,25 +460,54 @@ optimize_function(llvm::Function &F, LoopInfo &LI, DominatorTree &DT,
       exit(1);
     }
   }
-  config::set_debug(*out_file);
+  return out_file;
+}
 
-  debug() << "[online] minotaur version " << config::minotaur_version << " "
-          << "working on source: " << F.getParent()->getSourceFileName() << "\n";
+static void report_stats(const MinotaurContext &MC, raw_ostream &out) {
+  if (MC.show_stats)
+    out << "[online] peak rss: " << peak_rss() << " KB\n";
+}
 
-  debug() << "[online] working on function: " << F.getName() << "\n";
-  debug() << *F.getParent() << "\n";
+static void close_report(raw_ostream *out_file) {
+  if (out_file != &errs()) {
+    out_file->flush();
+    delete out_file;
+  }
+}
 
-  // set alive2 options
-  config::ignore_machine_cost = ignore_mca;
-  config::debug_enumerator = debug_enumerator;
-  config::debug_tv = debug_tv;
-  config::debug_slicer = debug_slicer;
-  config::debug_codegen = debug_codegen;
-  config::debug_parser = debug_parser;
-  config::slice_to = slice_to;
-  smt::solver_print_queries(smt_verbose);
+// the settings of this pass invocation, debug output goes to out
+static MinotaurContext make_context(raw_ostream &out) {
+  MinotaurContext MC;
+  MC.ignore_machine_cost = ignore_mca;
+  MC.debug_enumerator = debug_enumerator;
+  MC.debug_tv = debug_tv;
+  MC.debug_slicer = debug_slicer;
+  MC.debug_codegen = debug_codegen;
+  MC.debug_parser = debug_parser;
+  MC.slice_to = slice_to;
+  MC.max_inputs = max_inputs;
+  MC.max_tier = max_tier;
+  MC.smt_verbose = smt_verbose;
+  MC.show_stats = show_stats;
+  MC.return_first_solution = first_solution;
+  MC.set_debug(out);
 
+  // set alive2 options
   smt::set_query_timeout(to_string(smt_to * 1000));
+  return MC;
+}
+
+static bool
+optimize_function(llvm::Function &F, LoopInfo &LI, DominatorTree &DT,
+                  TargetLibraryInfoWrapperPass &TLI) {
+  raw_ostream *out_file = open_report();
+  MinotaurContext MC = make_context(*out_file);
+
+  debug(MC) << "[online] minotaur version " << config::minotaur_version << " "
+          << "working on source: " << F.getParent()->getSourceFileName() << "\n";
+
+  debug(MC) << "[online] working on function: " << F.getName() << "\n";
+  debug(MC) << *F.getParent() << "\n";
 
   redisContext *ctx = nullptr;
   if (enable_caching) {
@@ -320,7 +541,7 @@ optimize_function(llvm::Function &F, LoopInfo &LI, DominatorTree &DT,
       }
     }
     if (!ret) {
-      debug() << "[online] no return instruction found, skipping\n";
+      debug(MC) << "[online] no return instruction found, skipping\n";
       goto final;
     }
 
@@ -328,60 +549,78 @@ optimize_function(llvm::Function &F, LoopInfo &LI, DominatorTree &DT,
 
 
     if (!retI) {
-      debug() << "[online] return value is not an instruction, skipping\n";
+      debug(MC) << "[online] return value is not an instruction, skipping\n";
       goto final;
     }
 
-    Enumerator EN;
-    parse::Parser P(*newF);
-    auto R = infer(*newF, retI, ctx, EN, P);
+    Enumerator EN(MC);
+    parse::Parser P(*newF, MC);
+    auto R = infer(*newF, retI, ctx, EN, P, MC);
     if (!R.has_value()) {
       goto final;
     }
 
     unordered_set<llvm::Function*> IntrinDecls;
     ValueToValueMapTy vmap;
-    auto *V = LLVMGen(ret, IntrinDecls).codeGen(R->I, vmap);
+    auto *V = LLVMGen(ret, IntrinDecls, MC, common_fast_math_flags(*newF))
+                 .codeGen(R->I, vmap);
     V = llvm::IRBuilder<>(ret).CreateBitCast(V, retI->getType());
     retI->replaceAllUsesWith(V);
     changed = true;
   } else {
+    SliceCache SC(F, LI, DT, MC);
+    // the roots rewritten together are not sliced again on their own
+    unordered_set<Instruction*> Rewritten;
+    if (multi_root) {
+      for (auto &BB : F) {
+        for (auto &Roots : relatedRoots(BB)) {
+          auto S = make_slicer(SC);
+          auto NewF = S->extractExprs(Roots);
+          auto m = S->getNewModule();
+
+          if (!NewF.has_value())
+            continue;
+
+          Enumerator EN(MC);
+          parse::Parser P(NewF->first, MC);
+          auto R = infer(NewF->first, NewF->second, ctx, EN, P, MC);
+
+          if (!R.has_value())
+            continue;
+
+          if (apply_roots(Roots, R->I, S->getValueMap(), NewF->first, DT,
+                          MC)) {
+            Rewritten.insert(Roots.begin(), Roots.end());
+            SC.invalidate();
+            changed = true;
+          }
+        }
+      }
+    }
+
     for (auto &BB : F) {
       for (auto &I : make_early_inc_range(BB)) {
-        if (I.getType()->isVoidTy())
+        if (I.getType()->isVoidTy() || Rewritten.count(&I))
           continue;
 
-        DataLayout DL(F.getParent());
-        minotaur::Slice S(F, LI, DT);
-        auto NewF = S.extractExpr(I);
-        auto m = S.getNewModule();
+        auto S = make_slicer(SC);
+        auto NewF = S->extractExpr(I);
+        auto m = S->getNewModule();
 
         if (!NewF.has_value())
           continue;
 
-        Enumerator EN;
-        parse::Parser P(NewF->first);
-        auto R = infer(NewF->first, NewF->second, ctx, EN, P);
+        Enumerator EN(MC);
+        parse::Parser P(NewF->first, MC);
+        auto R = infer(NewF->first, NewF->second, ctx, EN, P, MC);
 
         if (!R.has_value())
           continue;
 
-        unordered_set<llvm::Function*> IntrinDecls;
-        Instruction *insertpt = I.getNextNode();
-        while(isa<PHINode>(insertpt)) {
-          insertpt = insertpt->getNextNode();
+        if (apply_rewrite(I, R->I, S->getValueMap(), NewF->first, DT, MC)) {
+          SC.invalidate();
+          changed = true;
         }
-
-        auto *V = LLVMGen(insertpt, IntrinDecls).codeGen(R->I, S.getValueMap());
-        V = llvm::IRBuilder<>(insertpt).CreateBitCast(V, I.getType());
-
-        I.replaceUsesWithIf(V, [&changed, &V, &DT](Use &U) {
-          if(dom_check(V, DT, U)) {
-            changed = true;
-            return true;
-          }
-          return false;
-        });
       }
     }
   }
@@ -397,16 +636,259 @@ final:
   }
 
   if (changed)
-    debug() << "[online] minotaur completed, changed the program\n";
+    debug(MC) << "[online] minotaur completed, changed the program\n";
   else {
-    debug() << "[online] minotaur completed, no change to the program\n";
+    debug(MC) << "[online] minotaur completed, no change to the program\n";
   }
 
-  if (out_file != &errs()) {
-    out_file->flush();
-    delete out_file;
+  report_stats(MC, *out_file);
+  close_report(out_file);
+
+  return changed;
+}
+
+// a slice extracted in the first phase of the module mode. the cut is kept
+// in the compiler's context for rewriting, while a bitcode copy is handed to
+// the workers, which synthesize it in a context of their own.
+struct SliceJob {
+  Instruction *I;
+  unique_ptr<Slicer> S;
+  unique_ptr<llvm::Module> M;
+  Function *Cut;
+  string RootName;
+  string Key;
+  SmallVector<char, 0> Bitcode;
+  optional<string> Rewrite;
+  string Log;
+};
+
+// the number of jobs a worker synthesizes in one LLVMContext
+static constexpr unsigned CONTEXT_JOBS = 64;
+
+// runs on a worker thread in the context C of the worker, which outlives
+// the job. debug output is buffered in the job and emitted in program
+// order once all workers are done
+static void synthesize_job(SliceJob &J, LLVMContext &C, MinotaurContext MC) {
+  raw_string_ostream log(J.Log);
+  MC.set_debug(log);
+
+  redisContext *ctx = nullptr;
+  if (enable_caching) {
+    ctx = redisConnect("127.0.0.1", redis_port);
+    if (!ctx || ctx->err)
+      report_fatal_error("[online] cannot connect to redis");
+  }
+
+  auto release = [&ctx]() {
+    if (ctx)
+      redisFree(ctx);
+  };
+
+  // a hit is only used once it decodes against the cut, see below
+  optional<string> Cached;
+  if (enable_caching && !force_infer) {
+    string rewrite;
+    switch (lookup_cache(J.Key, ctx, rewrite)) {
+    case CacheState::Hit:
+      Cached = std::move(rewrite);
+      break;
+    case CacheState::NoSolution:
+      release();
+      return;
+    case CacheState::Pending:
+      if (no_infer) {
+        release();
+        return;
+      }
+      break;
+    case CacheState::Miss:
+      break;
+    }
+  }
+
+  if (no_infer && !Cached) {
+    if (enable_caching)
+      hSetPending(J.Key.c_str(), J.Key.size(), ctx, J.Cut->getName());
+    release();
+    return;
+  }
+
+  auto MB = MemoryBuffer::getMemBuffer(
+    StringRef(J.Bitcode.data(), J.Bitcode.size()), "", false);
+  auto M = parseBitcodeFile(*MB, C);
+  if (!M) {
+    consumeError(M.takeError());
+    release();
+    return;
+  }
+
+  Function *F = (*M)->getFunction(J.Cut->getName());
+  auto *Root = F ? dyn_cast_or_null<Instruction>(
+    F->getValueSymbolTable()->lookup(J.RootName)) : nullptr;
+  if (!Root) {
+    release();
+    return;
+  }
+
+  // an entry that does not decode, e.g. from an older encoding, is treated
+  // as a miss. it is replaced by a pending entry right away, which the
+  // synthesis below or the offline workers overwrite
+  if (Cached) {
+    parse::Parser P(*F, MC);
+    if (!P.parse(*F, *Cached).empty()) {
+      J.Rewrite = std::move(*Cached);
+      release();
+      return;
+    }
+    debug(MC) << "[online] failed to parse cached solution, treating it as "
+                "a cache miss\n";
+    hSetPending(J.Key.c_str(), J.Key.size(), ctx, J.Cut->getName(), true);
+    if (no_infer) {
+      release();
+      return;
+    }
   }
 
+  Enumerator EN(MC);
+  auto R = search(*F, Root, EN, MC);
+  if (!R) {
+    if (enable_caching)
+      cache_no_solution(J.Key, ctx, J.Cut->getName(), MC);
+    release();
+    return;
+  }
+
+  string rewrite = serialize(R->I);
+  if (enable_caching)
+    cache_rewrite(J.Key, ctx, *R, rewrite, J.Cut->getName(), MC);
+  J.Rewrite = std::move(rewrite);
+  release();
+}
+
+static bool optimize_module(llvm::Module &M, ModuleAnalysisManager &MAM) {
+  raw_ostream *out_file = open_report();
+  MinotaurContext MC = make_context(*out_file);
+
+  debug(MC) << "[online] minotaur version " << config::minotaur_version << " "
+          << "working on source: " << M.getSourceFileName() << "\n";
+
+  FunctionAnalysisManager &FAM =
+    MAM.getResult<FunctionAnalysisManagerModuleProxy>(M).getManager();
+
+  // phase 1: extract every slice of every function
+  vector<SliceJob> Jobs;
+  // the slices keep referring to the cache of their function until the
+  // rewrites are applied
+  vector<unique_ptr<SliceCache>> Caches;
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    LoopInfo &LI = FAM.getResult<llvm::LoopAnalysis>(F);
+    DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    Caches.push_back(make_unique<SliceCache>(F, LI, DT, MC));
+
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (I.getType()->isVoidTy())
+          continue;
+
+        auto S = make_slicer(*Caches.back());
+        auto NewF = S->extractExpr(I);
+        auto m = S->getNewModule();
+
+        if (!NewF.has_value())
+          continue;
+
+        SliceJob J;
+        J.I = &I;
+        J.Cut = &NewF->first.get();
+        J.RootName = NewF->second->getName();
+
+        llvm::raw_string_ostream ks(J.Key);
+        m->print(ks, nullptr);
+        ks.flush();
+
+        BitcodeWriter BW(J.Bitcode);
+        BW.writeModule(*m);
+        BW.writeSymtab();
+        BW.writeStrtab();
+
+        J.S = std::move(S);
+        J.M = std::move(m);
+        Jobs.push_back(std::move(J));
+      }
+    }
+  }
+
+  // the default pipelines only run the module pass with threads, an explicit
+  // -passes=minotaur-module without them gets one per core
+  unsigned Threads = num_threads;
+  if (!Threads)
+    Threads = std::max(1u, thread::hardware_concurrency());
+  debug(MC) << "[online] " << Jobs.size() << " slices extracted, dispatching "
+          << "to " << Threads << " threads\n";
+
+  // phase 2: cache lookup and synthesis, each slice is independent
+  atomic<unsigned> next(0);
+  vector<thread> workers;
+  for (unsigned t = 0; t < Threads; ++t) {
+    workers.emplace_back([&Jobs, &next, &MC]() {
+      // the context of a worker is reused across its jobs, and replaced
+      // every CONTEXT_JOBS jobs so that its type and constant pools, which
+      // only grow, stay bounded
+      unique_ptr<LLVMContext> C;
+      unsigned Used = 0;
+      for (unsigned i = next++; i < Jobs.size(); i = next++) {
+        if (!C || Used == CONTEXT_JOBS) {
+          C = make_unique<LLVMContext>();
+          Used = 0;
+        }
+        ++Used;
+        synthesize_job(Jobs[i], *C, MC);
+      }
+    });
+  }
+  for (auto &w : workers)
+    w.join();
+
+  // phase 3: rewrite in program order on the main thread
+  bool changed = false;
+  unordered_set<llvm::Function*> ChangedFns;
+  for (auto &J : Jobs) {
+    MC.dbg() << J.Log;
+    if (!J.Rewrite.has_value())
+      continue;
+
+    parse::Parser P(*J.Cut, MC);
+    auto RHSs = P.parse(*J.Cut, *J.Rewrite);
+    if (RHSs.empty()) {
+      debug(MC) << "[online] failed to parse solution\n";
+      continue;
+    }
+
+    Function &F = *J.I->getFunction();
+    DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+    if (apply_rewrite(*J.I, RHSs[0].I, J.S->getValueMap(), *J.Cut, DT, MC)) {
+      ChangedFns.insert(&F);
+      changed = true;
+    }
+  }
+
+  for (auto F : ChangedFns) {
+    F->removeFnAttr("min-legal-vector-width");
+    eliminate_dead_code(*F);
+  }
+
+  if (changed)
+    debug(MC) << "[online] minotaur completed, changed the program\n";
+  else {
+    debug(MC) << "[online] minotaur completed, no change to the program\n";
+  }
+
+  report_stats(MC, *out_file);
+  close_report(out_file);
+
   return changed;
 }
 
@@ -472,6 +954,16 @@ struct SuperoptimizerPass : PassInfoMixin<SuperoptimizerPass> {
   }
 };
 
+struct SuperoptimizerModulePass : PassInfoMixin<SuperoptimizerModulePass> {
+  PreservedAnalyses run(llvm::Module &M, ModuleAnalysisManager &MAM) {
+    PreservedAnalyses PA;
+    PA.preserveSet<CFGAnalyses>();
+    if (!optimize_module(M, MAM))
+      return PreservedAnalyses::all();
+    return PA;
+  }
+};
+
 }// namespace
 
 bool pipelineParsingCallback(StringRef Name, FunctionPassManager &FPM,
@@ -483,11 +975,27 @@ bool pipelineParsingCallback(StringRef Name, FunctionPassManager &FPM,
   return false;
 }
 
+bool modulePipelineParsingCallback(StringRef Name, ModulePassManager &MPM,
+                                   ArrayRef<PassBuilder::PipelineElement>) {
+  if (Name == "minotaur-module") {
+    MPM.addPass(SuperoptimizerModulePass());
+    return true;
+  }
+  return false;
+}
+
 void passBuilderCallback(PassBuilder &PB) {
   PB.registerPipelineParsingCallback(pipelineParsingCallback);
+  PB.registerPipelineParsingCallback(modulePipelineParsingCallback);
   PB.registerVectorCombineCallback(
       [](llvm::FunctionPassManager &FPM, llvm::OptimizationLevel) {
-        FPM.addPass(SuperoptimizerPass());
+        if (!num_threads)
+          FPM.addPass(SuperoptimizerPass());
+      });
+  PB.registerOptimizerLastEPCallback(
+      [](llvm::ModulePassManager &MPM, llvm::OptimizationLevel) {
+        if (num_threads)
+          MPM.addPass(SuperoptimizerModulePass());
       });
 }
 
@@ -0,0 +1,7 @@
+; CHECK: call <4 x i32> @llvm.abs.v4i32(<4 x i32> %x, i1 false)
+define <4 x i32> @abs(<4 x i32> %x) {
+  %n = sub <4 x i32> zeroinitializer, %x
+  %c = icmp slt <4 x i32> %x, zeroinitializer
+  %r = select <4 x i1> %c, <4 x i32> %n, <4 x i32> %x
+  ret <4 x i32> %r
+}
@@ -0,0 +1,7 @@
+; adding zero is a nop without signed zeros, the rewrite keeps the flags
+; CHECK: fmul nnan nsz half %x, %y
+define half @add_zero(half %x, half %y) {
+  %a = fadd nnan nsz half %x, 0.0
+  %m = fmul nnan nsz half %a, %y
+  ret half %m
+}
@@ -0,0 +1,16 @@
+; CHECK: @llvm.fma.v2f32(
+define <2 x float> @fma_lanes(<2 x float> %a, <2 x float> %b, <2 x float> %c) {
+  %a0 = extractelement <2 x float> %a, i64 0
+  %b0 = extractelement <2 x float> %b, i64 0
+  %c0 = extractelement <2 x float> %c, i64 0
+  %a1 = extractelement <2 x float> %a, i64 1
+  %b1 = extractelement <2 x float> %b, i64 1
+  %c1 = extractelement <2 x float> %c, i64 1
+  %r0 = call float @llvm.fma.f32(float %a0, float %b0, float %c0)
+  %r1 = call float @llvm.fma.f32(float %a1, float %b1, float %c1)
+  %v0 = insertelement <2 x float> poison, float %r0, i64 0
+  %v1 = insertelement <2 x float> %v0, float %r1, i64 1
+  ret <2 x float> %v1
+}
+
+declare float @llvm.fma.f32(float, float, float)
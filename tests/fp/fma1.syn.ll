@@ -0,0 +1,7 @@
+; an fmul and fadd round twice, they cannot be fused without contract
+; CHECK-NOT: @llvm.fma
+define <4 x float> @mul_add(<4 x float> %a, <4 x float> %b, <4 x float> %c) {
+  %m = fmul <4 x float> %a, %b
+  %r = fadd <4 x float> %m, %c
+  ret <4 x float> %r
+}
@@ -0,0 +1,6 @@
+; CHECK: @llvm.fmuladd.v4f32(
+define <4 x float> @mul_add(<4 x float> %a, <4 x float> %b, <4 x float> %c) {
+  %m = fmul contract <4 x float> %a, %b
+  %r = fadd contract <4 x float> %m, %c
+  ret <4 x float> %r
+}
@@ -0,0 +1,14 @@
+; TEST-ARGS: -passes=minotaur-module -minotaur-threads=2
+; every function is sliced first, the slices are synthesized by two threads
+; CHECK: add i4 %x, -3
+define i4 @syn_add(i4 %x, i4 %y) {
+  %ia = sub i4 %x, 7
+  %ib = add i4 %ia, 4
+  ret i4 %ib
+}
+
+define <4 x i32> @syn_and(<4 x i32> %x, <4 x i32> %y) {
+  %a = and <4 x i32> %x, %y
+  %b = and <4 x i32> %a, %x
+  ret <4 x i32> %b
+}
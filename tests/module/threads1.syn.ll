@@ -0,0 +1,8 @@
+; TEST-ARGS: -passes=minotaur-module
+; without -minotaur-threads the module pass still runs its workers
+; CHECK: add i4 %x, -3
+define i4 @syn_add(i4 %x, i4 %y) {
+  %ia = sub i4 %x, 7
+  %ib = add i4 %ia, 4
+  ret i4 %ib
+}
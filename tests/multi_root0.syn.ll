@@ -0,0 +1,14 @@
+; TEST-ARGS: -minotaur-multi-root
+; the low half is only used truncated, so the cut masks it to its demanded
+; bits. the masked root is no input of the joint rewrite, which is a single
+; shuffle of %x and %y the high half is extracted from
+; CHECK: <4 x i32> <i32 4, i32 5, i32 6, i32 7>
+; CHECK-NOT: does not dominate all uses
+define <4 x i16> @unpack_masked(<4 x i32> %x, <4 x i32> %y) {
+  %lo = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 0, i32 4, i32 1, i32 5>
+  %hi = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 2, i32 6, i32 3, i32 7>
+  %t = trunc <4 x i32> %lo to <4 x i16>
+  %u = trunc <4 x i32> %hi to <4 x i16>
+  %r = add <4 x i16> %t, %u
+  ret <4 x i16> %r
+}
@@ -0,0 +1,12 @@
+; TEST-ARGS: -minotaur-multi-root
+; unpacklo and unpackhi of the same vectors are one shuffle of %x and %y
+; into eight lanes. both roots are replaced with its halves, so the high
+; half is extracted and the unpackhi is gone
+; CHECK: <4 x i32> <i32 4, i32 5, i32 6, i32 7>
+; CHECK-NOT: <4 x i32> <i32 2, i32 6, i32 3, i32 7>
+define <4 x i32> @unpack(<4 x i32> %x, <4 x i32> %y) {
+  %lo = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 0, i32 4, i32 1, i32 5>
+  %hi = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 2, i32 6, i32 3, i32 7>
+  %r = add <4 x i32> %lo, %hi
+  ret <4 x i32> %r
+}
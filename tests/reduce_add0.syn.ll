@@ -0,0 +1,12 @@
+; the extract and add tree over all the lanes is one reduction
+; CHECK: call i32 @llvm.vector.reduce.add.v4i32(<4 x i32> %x)
+define i32 @sum(<4 x i32> %x) {
+  %e0 = extractelement <4 x i32> %x, i64 0
+  %e1 = extractelement <4 x i32> %x, i64 1
+  %e2 = extractelement <4 x i32> %x, i64 2
+  %e3 = extractelement <4 x i32> %x, i64 3
+  %a = add i32 %e0, %e1
+  %b = add i32 %e2, %e3
+  %r = add i32 %a, %b
+  ret i32 %r
+}
@@ -0,0 +1,8 @@
+; a rotate by a constant is a funnel shift of %x with itself
+; CHECK: (<4 x i32> %x, <4 x i32> %x, <4 x i32> <i32
+define <4 x i32> @rotl(<4 x i32> %x) {
+  %l = shl <4 x i32> %x, <i32 7, i32 7, i32 7, i32 7>
+  %h = lshr <4 x i32> %x, <i32 25, i32 25, i32 25, i32 25>
+  %r = or <4 x i32> %l, %h
+  ret <4 x i32> %r
+}
@@ -0,0 +1,8 @@
+; the add is clamped to all ones when it wraps
+; CHECK: @llvm.uadd.sat.v16i8(
+define <16 x i8> @uadd_sat(<16 x i8> %x, <16 x i8> %y) {
+  %a = add <16 x i8> %x, %y
+  %c = icmp ult <16 x i8> %a, %x
+  %r = select <16 x i1> %c, <16 x i8> <i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1, i8 -1>, <16 x i8> %a
+  ret <16 x i8> %r
+}
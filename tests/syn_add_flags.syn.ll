@@ -0,0 +1,7 @@
+; the rewrite keeps the flags that still refine the source
+; CHECK: add nuw nsw <4 x i32> %x, <i32 2, i32 2, i32 2, i32 2>
+define <4 x i32> @add_twice(<4 x i32> %x) {
+  %a = add nuw nsw <4 x i32> %x, <i32 1, i32 1, i32 1, i32 1>
+  %b = add nuw nsw <4 x i32> %a, <i32 1, i32 1, i32 1, i32 1>
+  ret <4 x i32> %b
+}
@@ -0,0 +1,8 @@
+; only the low bit of the product is used, it is the and of the low bits
+; CHECK: and <4 x i32> %x, %y
+define <4 x i8> @low_bit(<4 x i32> %x, <4 x i32> %y) {
+  %a = mul <4 x i32> %x, %y
+  %m = and <4 x i32> %a, <i32 1, i32 1, i32 1, i32 1>
+  %t = trunc <4 x i32> %m to <4 x i8>
+  ret <4 x i8> %t
+}
@@ -107,9 +107,6 @@ int main(int argc, char **argv) {
                                     "Minotaur stand-alone Constant Synthesizer\n");
 
   smt::set_query_timeout(to_string(opt_smt_to));
-  smt::solver_print_queries(opt_smt_verbose);
-  config::disable_undef_input = opt_disable_undef;
-  config::disable_poison_input = opt_disable_poison;
   config::debug = opt_debug;
 
   auto M = openInputFile(Context, opt_file);
@@ -136,9 +133,13 @@ int main(int argc, char **argv) {
   if (!any_of(TGT->args(), check_name))
     report_fatal_error("could not find reservedconst argument in tgt");
 
-  minotaur::config::debug_tv = true;
+  minotaur::MinotaurContext MC;
+  MC.debug_tv = true;
+  MC.disable_undef_input = opt_disable_undef;
+  MC.smt_verbose = opt_smt_verbose;
+  MC.set_debug(errs());
   unordered_map<Argument*, Constant*> constMap;
-  minotaur::AliveEngine AE(TLI, true);
+  minotaur::AliveEngine AE(TLI, opt_disable_poison, MC);
   try {
     AE.constantSynthesis(*SRC, *TGT, constMap);
   } catch (AliveException e) {
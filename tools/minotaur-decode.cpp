@@ -0,0 +1,94 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+#include "config.h"
+#include "parse.h"
+#include "serialize.h"
+
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IRReader/IRReader.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace std;
+using namespace llvm;
+using namespace minotaur;
+
+static cl::OptionCategory minotaur_decode("minotaur-decode options");
+
+static cl::opt<string> opt_cut(cl::Positional, cl::desc("cut_file"),
+  cl::Required, cl::value_desc("filename"),
+  cl::cat(minotaur_decode));
+
+static cl::opt<string> opt_rewrite(cl::Positional, cl::desc("rewrite_file"),
+  cl::Required, cl::value_desc("filename"),
+  cl::cat(minotaur_decode));
+
+static cl::opt<bool> opt_size("size",
+  cl::desc("print the size of the binary and the textual encoding"),
+  cl::init(false), cl::cat(minotaur_decode));
+
+static ExitOnError ExitOnErr;
+
+// the cut of a slice is named "cut", whole-function cuts keep their name
+static Function *findCut(Module &M) {
+  if (auto F = M.getFunction("cut"))
+    return F;
+  for (auto &F : M)
+    if (!F.isDeclaration())
+      return &F;
+  return nullptr;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal(argv[0]);
+  PrettyStackTraceProgram X(argc, argv);
+  EnableDebugBuffering = true;
+  llvm_shutdown_obj llvm_shutdown;  // Call llvm_shutdown() on exit.
+  LLVMContext Context;
+
+  cl::ParseCommandLineOptions(argc, argv,
+                              "Minotaur cached rewrite decoder\n");
+
+  SMDiagnostic Diag;
+  auto M = parseIRFile(opt_cut, Diag, Context);
+  if (!M) {
+    Diag.print(argv[0], errs());
+    return 1;
+  }
+
+  Function *F = findCut(*M);
+  if (!F)
+    report_fatal_error("could not find the cut function");
+
+  auto MB = ExitOnErr(errorOrToExpected(MemoryBuffer::getFile(opt_rewrite)));
+  StringRef Buf = MB->getBuffer();
+
+  MinotaurContext MC;
+  parse::Parser P(*F, MC);
+  auto RHSs = P.parse(*F, Buf);
+  if (RHSs.empty()) {
+    errs() << "could not decode the rewrite\n";
+    return 1;
+  }
+
+  RHSs[0].I->print(outs());
+  outs() << "\n";
+
+  if (opt_size) {
+    string text;
+    raw_string_ostream os(text);
+    RHSs[0].I->print(os);
+    os.flush();
+    outs() << "binary: " << serialize(RHSs[0].I).size() << " bytes, "
+           << "text: " << text.size() << " bytes\n";
+  }
+
+  return 0;
+}
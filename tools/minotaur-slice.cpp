@@ -2,6 +2,7 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 #include "slice.h"
 #include "config.h"
+#include "removal-slice.h"
 
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/Analysis/PostDominators.h"
@@ -17,6 +18,11 @@
 #include "llvm/Support/PrettyStackTrace.h"
 #include "llvm/Support/Signals.h"
 #include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <set>
 
 using namespace std;
 using namespace llvm;
@@ -32,8 +38,82 @@ static cl::opt<bool> dump_files("dump-files",
   llvm::cl::desc("if enabled, dump the sliced bitcode to files"),
   llvm::cl::init(false), llvm::cl::cat(minotaur_slice));
 
+enum class SlicerKind { Forward, Removal };
+
+static cl::opt<SlicerKind> slicer_kind("slicer",
+  cl::desc("slicer used to extract cuts"),
+  cl::values(
+    clEnumValN(SlicerKind::Forward, "forward",
+               "grow the cut from the root (default)"),
+    clEnumValN(SlicerKind::Removal, "removal",
+               "copy the region of the root, remove what it does not use")),
+  cl::init(SlicerKind::Forward), cl::cat(minotaur_slice));
+
+static cl::opt<bool> compare("compare",
+  llvm::cl::desc("slice every instruction with both slicers and report the "
+                 "time, the size of the cuts and how many of them are "
+                 "distinct cache keys"),
+  llvm::cl::init(false), llvm::cl::cat(minotaur_slice));
+
 static llvm::ExitOnError ExitOnErr;
 
+static unique_ptr<Slicer> makeSlicer(SlicerKind K, SliceCache &SC) {
+  if (K == SlicerKind::Removal)
+    return make_unique<RemovalSlice>(SC);
+  return make_unique<Slice>(SC);
+}
+
+struct SliceStats {
+  unsigned Roots = 0, Cuts = 0, Insts = 0, Blocks = 0;
+  set<string> Keys;
+  chrono::steady_clock::duration Time{};
+};
+
+static SliceStats sliceAll(Module &M, SlicerKind K, MinotaurContext &MC) {
+  SliceStats St;
+  for (auto &F : M) {
+    if (F.isDeclaration())
+      continue;
+
+    llvm::PassBuilder PB;
+    llvm::FunctionAnalysisManager FAM;
+    PB.registerFunctionAnalyses(FAM);
+    LoopInfo &LI = FAM.getResult<LoopAnalysis>(F);
+    DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
+
+    auto Start = chrono::steady_clock::now();
+    SliceCache SC(F, LI, DT, MC);
+    vector<unique_ptr<Module>> Cuts;
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (I.getType()->isVoidTy())
+          continue;
+        ++St.Roots;
+        auto S = makeSlicer(K, SC);
+        auto NewF = S->extractExpr(I);
+        auto m = S->getNewModule();
+        if (!NewF.has_value())
+          continue;
+        ++St.Cuts;
+        St.Blocks += NewF->first.get().size();
+        St.Insts += NewF->first.get().getInstructionCount();
+        Cuts.push_back(std::move(m));
+      }
+    }
+    St.Time += chrono::steady_clock::now() - Start;
+
+    // the cache is keyed by the printed module
+    for (auto &m : Cuts) {
+      string Key;
+      raw_string_ostream ks(Key);
+      m->print(ks, nullptr);
+      ks.flush();
+      St.Keys.insert(std::move(Key));
+    }
+  }
+  return St;
+}
+
 // adapted from llvm-dis.cpp
 static std::unique_ptr<Module> openInputFile(LLVMContext &Context,
                                              string InputFilename) {
@@ -56,12 +136,29 @@ int main(int argc, char **argv) {
   llvm::llvm_shutdown_obj llvm_shutdown; // Call llvm_shutdown() on exit.
   llvm::LLVMContext Context;
 
-  config::debug_slicer = true;
+  MinotaurContext MC;
+  MC.debug_slicer = true;
+  MC.set_debug(llvm::errs());
 
   llvm::cl::ParseCommandLineOptions(argc, argv, "Minotaur Program Slicer\n");
 
   auto M = openInputFile(Context, opt_file);
 
+  if (compare) {
+    MC.debug_slicer = false;
+    outs() << "slicer   roots   cuts   insts  blocks    keys   time(ms)\n";
+    for (auto K : {SlicerKind::Forward, SlicerKind::Removal}) {
+      auto St = sliceAll(*M, K, MC);
+      const char *Name = K == SlicerKind::Forward ? "forward" : "removal";
+      outs() << format("%-7s %6u %6u %7u %7u %7u %10lld\n", Name,
+                       St.Roots, St.Cuts, St.Insts, St.Blocks,
+                       (unsigned)St.Keys.size(),
+                       (long long)chrono::duration_cast<chrono::milliseconds>(
+                         St.Time).count());
+    }
+    return 0;
+  }
+
   for (auto &F : *M) {
     if (F.isDeclaration())
       continue;
@@ -75,13 +172,14 @@ int main(int argc, char **argv) {
     DominatorTree &DT = FAM.getResult<DominatorTreeAnalysis>(F);
     //MemoryDependenceResults &MD = FAM.getResult<MemoryDependenceAnalysis>(F);
 
+    SliceCache SC(F, LI, DT, MC);
     unsigned count = 0;
     for (auto &BB : F) {
       for (auto &I : BB) {
-        Slice S(F, LI, DT);
         if (I.getType()->isVoidTy())
           continue;
-        S.extractExpr(I);
+        auto S = makeSlicer(slicer_kind, SC);
+        S->extractExpr(I);
 
         if (!dump_files)
           continue;
@@ -97,4 +195,4 @@ int main(int argc, char **argv) {
   }
 
   return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "gtest/gtest.h"
+#include "utils.h"
+
+#include "hiredis.h"
+
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+using namespace minotaur;
+
+// the number of times Key was queued for the offline workers, the queue
+// entries are removed
+static long long unqueue(redisContext *c, const string &Key) {
+  auto *reply = (redisReply *)redisCommand(c, "LREM %s 0 %b", PENDING_QUEUE,
+                                           Key.data(), Key.size());
+  long long n = reply && reply->type == REDIS_REPLY_INTEGER ? reply->integer
+                                                            : -1;
+  freeReplyObject(reply);
+  return n;
+}
+
+// runs against the redis server the pass uses, and is skipped without one
+TEST(CacheTest, ForcedPendingReplacesEntry) {
+  redisContext *c = redisConnect("127.0.0.1", 6379);
+  if (!c || c->err) {
+    if (c)
+      redisFree(c);
+    GTEST_SKIP() << "no redis server on port 6379";
+  }
+
+  string Key = "minotaur-cache-test-" + to_string(getpid());
+  // a rewrite the parser cannot decode, e.g. from another encoding
+  string Stale = "\x7fMNT\x7f";
+  hSetRewrite(Key.data(), Key.size(), "", 0, Stale, c, 1, 2, "f");
+
+  // a cut known to the cache is left alone
+  string V;
+  EXPECT_FALSE(hSetPending(Key.data(), Key.size(), c, "f"));
+  ASSERT_TRUE(hGet(Key.data(), Key.size(), V, c));
+  EXPECT_EQ(V, Stale);
+  EXPECT_EQ(unqueue(c, Key), 0);
+
+  // unless it is replaced on purpose, then it is queued again
+  EXPECT_TRUE(hSetPending(Key.data(), Key.size(), c, "f", true));
+  ASSERT_TRUE(hGet(Key.data(), Key.size(), V, c));
+  EXPECT_EQ(V, "<pending>");
+  EXPECT_EQ(unqueue(c, Key), 1);
+
+  freeReplyObject(redisCommand(c, "DEL %b", Key.data(), Key.size()));
+  redisFree(c);
+}
@@ -0,0 +1,187 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "gtest/gtest.h"
+#include "config.h"
+#include "enumerator.h"
+#include "slice.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace minotaur;
+
+static const char *Source = R"(
+define <4 x i32> @src(<4 x i32> %x, <4 x i32> %y) {
+entry:
+  %a = add <4 x i32> %x, %x
+  %b = and <4 x i32> %a, %y
+  ret <4 x i32> %b
+}
+)";
+
+// runs the slicer and the synthesizer on every instruction of @src in a
+// private LLVMContext, and returns the printed rewrites
+static string synthesize(MinotaurContext &MC) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(Source, Err, C);
+  if (!M)
+    return "<parse error>";
+
+  llvm::Function &F = *M->getFunction("src");
+  llvm::DominatorTree DT(F);
+  llvm::LoopInfo LI(DT);
+
+  string result;
+  llvm::raw_string_ostream rs(result);
+  for (auto &BB : F) {
+    for (auto &I : BB) {
+      if (I.getType()->isVoidTy())
+        continue;
+
+      Slice S(F, LI, DT, MC);
+      auto NewF = S.extractExpr(I);
+      auto m = S.getNewModule();
+      if (!NewF.has_value())
+        continue;
+
+      Enumerator EN(MC);
+      auto RHSs = EN.solve(NewF->first, NewF->second);
+      rs << I.getName() << ":";
+      if (!RHSs.empty())
+        RHSs[0].I->print(rs);
+      rs << "\n";
+    }
+  }
+  rs.flush();
+  return result;
+}
+
+static MinotaurContext make_context() {
+  MinotaurContext MC;
+  MC.ignore_machine_cost = true;
+  MC.return_first_solution = true;
+  MC.slice_to = 60;
+  return MC;
+}
+
+TEST(ConcurrencyTest, SynthesisIsDeterministic) {
+  MinotaurContext MC = make_context();
+  string Expected = synthesize(MC);
+  ASSERT_FALSE(Expected.empty());
+
+  constexpr unsigned NumThreads = 8;
+  vector<string> Results(NumThreads);
+  vector<thread> Workers;
+  for (unsigned i = 0; i < NumThreads; ++i) {
+    Workers.emplace_back([&Results, i]() {
+      MinotaurContext MC = make_context();
+      Results[i] = synthesize(MC);
+    });
+  }
+  for (auto &W : Workers)
+    W.join();
+
+  for (auto &R : Results)
+    EXPECT_EQ(R, Expected);
+}
+
+TEST(ConcurrencyTest, DebugOutputIsPerContext) {
+  constexpr unsigned NumThreads = 8;
+  vector<string> Logs(NumThreads);
+  vector<thread> Workers;
+  for (unsigned i = 0; i < NumThreads; ++i) {
+    Workers.emplace_back([&Logs, i]() {
+      llvm::raw_string_ostream os(Logs[i]);
+      MinotaurContext MC = make_context();
+      MC.debug_slicer = i % 2 == 0;
+      MC.debug_enumerator = i % 2 == 0;
+      MC.debug_tv = i % 2 == 0;
+      MC.set_debug(os);
+      synthesize(MC);
+      os.flush();
+    });
+  }
+  for (auto &W : Workers)
+    W.join();
+
+  for (unsigned i = 0; i < NumThreads; ++i) {
+    if (i % 2 == 0) {
+      EXPECT_NE(Logs[i].find("[slicer]"), string::npos);
+      EXPECT_NE(Logs[i].find("[enumerator]"), string::npos);
+      // the transforms alive2 prints
+      EXPECT_NE(Logs[i].find("=>"), string::npos);
+    } else {
+      EXPECT_TRUE(Logs[i].empty());
+    }
+  }
+}
+
+// runs the streaming search on the slice of %b
+static SolveStats stream(MinotaurContext &MC, const RewriteCallback &OnRewrite,
+                         const CancelToken *Cancel) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(Source, Err, C);
+  llvm::Function &F = *M->getFunction("src");
+  llvm::DominatorTree DT(F);
+  llvm::LoopInfo LI(DT);
+
+  llvm::Instruction *Root = nullptr;
+  for (auto &I : F.getEntryBlock())
+    if (I.getName() == "b")
+      Root = &I;
+
+  Slice S(F, LI, DT, MC);
+  auto NewF = S.extractExpr(*Root);
+  auto m = S.getNewModule();
+  if (!NewF.has_value())
+    return {};
+
+  Enumerator EN(MC);
+  return EN.solve(NewF->first, NewF->second, OnRewrite, Cancel);
+}
+
+TEST(ConcurrencyTest, StreamingStopsOnRequest) {
+  MinotaurContext MC = make_context();
+  MC.return_first_solution = false;
+
+  unsigned Reported = 0;
+  auto Stats = stream(MC, [&Reported](const Rewrite &, const SolveStats &S) {
+    ++Reported;
+    EXPECT_GE(S.proven, Reported);
+    return false;
+  }, nullptr);
+
+  // the search ends with the first rewrite reported
+  EXPECT_LE(Reported, 1u);
+  EXPECT_GE(Stats.proven, Reported);
+  EXPECT_GE(Stats.queried, Stats.proven);
+  EXPECT_GE(Stats.generated, Stats.queried);
+}
+
+TEST(ConcurrencyTest, CancelledSearchMakesNoQueries) {
+  MinotaurContext MC = make_context();
+  CancelToken Cancel;
+  Cancel.cancel();
+
+  unsigned Reported = 0;
+  auto Stats = stream(MC, [&Reported](const Rewrite &, const SolveStats &) {
+    ++Reported;
+    return true;
+  }, &Cancel);
+
+  EXPECT_EQ(Reported, 0u);
+  EXPECT_EQ(Stats.queried, 0u);
+}
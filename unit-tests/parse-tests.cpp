@@ -2,48 +2,200 @@
 // Distributed under the MIT license that can be found in the LICENSE file.
 
 #include "gtest/gtest.h"
+#include "config.h"
 #include "parse.h"
+#include "serialize.h"
 
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <chrono>
+#include <iostream>
 #include <sstream>
+#include <thread>
 
 using namespace std;
 using namespace minotaur;
 
-#if 0
+static const char *Source = R"(
+define <8 x i32> @f(<8 x i32> %x, <8 x i32> %y, <8 x i16> %w, <4 x float> %p) {
+  ret <8 x i32> %x
+}
+)";
+
+static const string Tests[] = {
+  "(add <8 x i32> (var <8 x i32> %x) (var <8 x i32> %y))",
+  "(sub <4 x i64> (var <8 x i32> %x) (var <8 x i32> %y))",
+  "(add nuw nsw <8 x i32> (var <8 x i32> %x) (var <8 x i32> %y))",
+  "(or disjoint <8 x i32> (var <8 x i32> %x) (var <8 x i32> %y))",
+  "(and <8 x i32> (var <8 x i32> %x) (reservedconst <8 x i32> "
+    "|<8 x i32> <i32 1, i32 2, i32 3, i32 4, i32 5, i32 6, i32 7, i32 8>|))",
+  "(copy (reservedconst <4 x i64> "
+    "|<4 x i64> <i64 1, i64 0, i64 2, i64 -3>|))",
+  "(ctpop <8 x i32> (var <8 x i32> %x))",
+  "(icmp_ult (var <8 x i32> %x) (var <8 x i32> %y) b8)",
+  "(fcmp_true (var <4 x float> %p) (var <4 x float> %p) b4)",
+  "(fadd <4 x float> (var <4 x float> %p) (var <4 x float> %p))",
+  "(select (icmp_slt (var <8 x i32> %x) (var <8 x i32> %y) b8) "
+    "(var <8 x i32> %x) (var <8 x i32> %y))",
+  "(shuffle <8 x i32> (var <8 x i32> %x) (reservedconst <8 x i32> "
+    "|<8 x i32> <i32 1, i32 0, i32 3, i32 2, i32 5, i32 4, i32 7, i32 6>|))",
+  "(add <8 x i32> (blend <8 x i32> (var <8 x i32> %x) (var <8 x i32> %y) "
+    "(reservedconst <8 x i32> "
+    "|<8 x i32> <i32 0, i32 9, i32 2, i32 11, i32 4, i32 13, i32 6, i32 15>|)) "
+    "(var <8 x i32> %y))",
+  "(abs <16 x i16> (var <8 x i32> %x))",
+  "(uadd_sat <32 x i8> (var <8 x i32> %x) (var <8 x i32> %y))",
+  "(rotl <8 x i32> (var <8 x i32> %x) (var <8 x i32> %y))",
+  "(fshr <4 x i64> (var <8 x i32> %x) (var <8 x i32> %y) "
+    "(var <8 x i32> %x))",
+  "(fmuladd <4 x float> (var <4 x float> %p) (var <4 x float> %p) "
+    "(var <4 x float> %p))",
+  "(reduce_add <8 x i32> (var <8 x i32> %x))",
+  "(reduce_umax <16 x i16> (var <8 x i32> %y))",
+  "(reduce_fadd <4 x float> (var <4 x float> %p))",
+  "(conv_zext (var <8 x i16> %w) <8 x i16> <8 x i32>)",
+  "(conv_sitofp (var <8 x i32> %x) <8 x float>)",
+  "(x86_avx2_pmadd_wd (var <8 x i32> %x) (var <8 x i32> %y))",
+  "(x86_avx2_pblendvb (var <8 x i32> %x) (var <8 x i32> %y) "
+    "(var <8 x i32> %x))",
+};
+
+static unique_ptr<llvm::Module> makeModule(llvm::LLVMContext &C) {
+  llvm::SMDiagnostic Err;
+  return llvm::parseAssemblyString(Source, Err, C);
+}
+
+static string roundTrip(parse::Parser &P, llvm::Function &F, const string &T) {
+  auto RHSs = P.parse(F, T);
+  if (RHSs.empty())
+    return "<parse error>";
+  string rs;
+  llvm::raw_string_ostream os(rs);
+  RHSs[0].I->print(os);
+  os.flush();
+  return rs;
+}
 
 TEST(ParseTest, RoundTrip) {
-  std::string Tests[] = {
-    "(add <1 x i32> (var b4 %0) (var b4 %0))",
-    "(sub <1 x i8> (var b4 %0) (var b4 %0))",
-    "(sub <1 x i8> (var b4 %0) (const i4 6))",
-    "(sub <2 x i8> (var b16 %0) (var b16 %0))",
-    "(sub <2 x i8> (var b16 %0) (var b16 %1))",
-    "(sub <2 x i8> (var b16 %0) (const <2 x i4> {6,8}))",
-    "(and <1 x i64> (var b64 %8) (const i64 18446744073709551612))",
-    "(copy (const <4 x i32> {1,0,2,3}))",
-    "(icmp_ult (var b32 %0) (const i32 3) b1)",
-    "(shuffle <32 x i32> (var b64 %0) (const <32 x i8> {0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1}))",
-    "(blend <32 x i32> (var b64 %0) (var b64 %0) (const <32 x i8> {0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1,0,1}))",
-    "(conv_zext (var b8 %0) <1 x i8> <1 x i64>)",
-    "(conv_sext (var b8 %0) <1 x i8> <1 x i64>)",
-    "(conv_trunc (var b8 %0) <1 x i64> <1 x i8>)",
-    "(x86_sse2_pmadd_wd (var b128 %0) (var b128 %0))"
-  };
+  llvm::LLVMContext C;
+  auto M = makeModule(C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("f");
+
+  MinotaurContext MC;
+  parse::Parser P(F, MC);
+  for (const auto &T : Tests)
+    EXPECT_EQ(roundTrip(P, F, T), T);
+}
+
+TEST(ParseTest, MalformedInput) {
+  llvm::LLVMContext C;
+  auto M = makeModule(C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("f");
+
+  MinotaurContext MC;
+  parse::Parser P(F, MC);
+  EXPECT_TRUE(P.parse(F, "").empty());
+  EXPECT_TRUE(P.parse(F, "(add <8 x i32> (var <8 x i32> %x)").empty());
+  EXPECT_TRUE(P.parse(F, "(add <8 x i32> (var <8 x i32> %z) "
+                         "(var <8 x i32> %x))").empty());
+  EXPECT_TRUE(P.parse(F, "(add <8 x i32> ? (var <8 x i32> %x))").empty());
+  EXPECT_TRUE(P.parse(F, "(xor nsw <8 x i32> (var <8 x i32> %x) "
+                         "(var <8 x i32> %y))").empty());
+  // the parser is usable after an error
+  EXPECT_EQ(roundTrip(P, F, Tests[0]), Tests[0]);
+}
 
+// the binary encoding decodes to the same expression as the text it was
+// produced from, and is rejected when truncated
+TEST(ParseTest, BinaryRoundTrip) {
+  llvm::LLVMContext C;
+  auto M = makeModule(C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("f");
+
+  MinotaurContext MC;
+  parse::Parser P(F, MC);
   for (const auto &T : Tests) {
-    vector<unique_ptr<minotaur::Inst>> exprs;
-    minotaur::Inst *I = nullptr;
-    try {
-      Parse p;
-      I = parse::parse(T, exprs);
-    } catch (parse::ParseException E) {
-      cerr<<E.str<<" at "<<E.lineno<<", in test case "<<T<<endl;
-    }
-    ASSERT_TRUE(I != nullptr);
-    std::stringstream rs;
-    I->print(rs);
-    rs.flush();
-    EXPECT_EQ(rs.str(), T);
+    auto RHSs = P.parse(F, T);
+    ASSERT_FALSE(RHSs.empty()) << T;
+    string Bin = serialize(RHSs[0].I);
+    EXPECT_TRUE(isSerialized(Bin));
+    EXPECT_LT(Bin.size(), T.size()) << T;
+    EXPECT_EQ(roundTrip(P, F, Bin), T);
+    EXPECT_TRUE(P.parse(F, Bin.substr(0, Bin.size() - 1)).empty()) << T;
+  }
+}
+
+// entries cached by version 1 of the encoding, before binary operations
+// had flags, still decode, and later versions are rejected
+TEST(ParseTest, BinaryVersion1) {
+  llvm::LLVMContext C;
+  auto M = makeModule(C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("f");
+
+  MinotaurContext MC;
+  parse::Parser P(F, MC);
+  auto RHSs = P.parse(F, Tests[0]);
+  ASSERT_FALSE(RHSs.empty());
+  string Bin = serialize(RHSs[0].I);
+  // the root is the add, its fields are the kind, the operation, the flags,
+  // the type and the two operands, each one byte long
+  ASSERT_EQ(Bin[4], char(SERIALIZE_VERSION));
+  ASSERT_EQ(Bin[Bin.size() - 4], 0);
+
+  string V1 = Bin;
+  V1[4] = 1;
+  V1.erase(V1.size() - 4, 1);
+  EXPECT_EQ(roundTrip(P, F, V1), Tests[0]);
+
+  string Next = Bin;
+  Next[4] = SERIALIZE_VERSION + 1;
+  EXPECT_TRUE(P.parse(F, Next).empty());
+}
+
+// every thread parses the whole test set repeatedly with its own parser,
+// reports the throughput and checks that the results are not interleaved
+TEST(ParseTest, ConcurrentRoundTrip) {
+  constexpr unsigned NumThreads = 8;
+  constexpr unsigned Rounds = 200;
+
+  vector<unsigned> Failures(NumThreads, 0);
+  vector<thread> Workers;
+  auto Start = chrono::steady_clock::now();
+  for (unsigned i = 0; i < NumThreads; ++i) {
+    Workers.emplace_back([&Failures, i]() {
+      llvm::LLVMContext C;
+      auto M = makeModule(C);
+      if (!M) {
+        ++Failures[i];
+        return;
+      }
+      llvm::Function &F = *M->getFunction("f");
+      MinotaurContext MC;
+      for (unsigned r = 0; r < Rounds; ++r) {
+        parse::Parser P(F, MC);
+        for (const auto &T : Tests)
+          if (roundTrip(P, F, T) != T)
+            ++Failures[i];
+      }
+    });
   }
+  for (auto &W : Workers)
+    W.join();
+  auto Elapsed = chrono::duration_cast<chrono::milliseconds>(
+    chrono::steady_clock::now() - Start).count();
+
+  unsigned Parsed = NumThreads * Rounds * size(Tests);
+  cout << "[ParseTest] " << Parsed << " rewrites parsed on " << NumThreads
+       << " threads in " << Elapsed << "ms\n";
+
+  for (unsigned i = 0; i < NumThreads; ++i)
+    EXPECT_EQ(Failures[i], 0u) << "thread " << i;
 }
-#endif
\ No newline at end of file
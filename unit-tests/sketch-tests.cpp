@@ -0,0 +1,215 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "gtest/gtest.h"
+#include "lanes.h"
+#include "sketch.h"
+#include "target.h"
+
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/SourceMgr.h"
+#include "llvm/Support/raw_ostream.h"
+
+#include <string>
+
+using namespace std;
+using namespace minotaur;
+
+static const char *Source = R"(
+define <4 x i32> @f(<4 x i32> %x, <4 x i32> %y, <8 x i16> %w) {
+  ret <4 x i32> %x
+}
+)";
+
+static string str(Inst *I) {
+  string s;
+  llvm::raw_string_ostream os(s);
+  I->print(os);
+  os.flush();
+  return s;
+}
+
+// (add _0 rc) and (sub _0 _1) over two <4 x i32> slots
+static unique_ptr<SketchTemplate> makeTemplate() {
+  auto T = make_unique<SketchTemplate>();
+  type ty = type::IntegerVectorizable(4, 32);
+  for (unsigned i = 0; i < 2; ++i) {
+    auto P = make_unique<Var>("%_" + to_string(i), ty);
+    T->slots.push_back(P.get());
+    T->exprs.emplace_back(std::move(P));
+  }
+  auto RC = make_unique<ReservedConst>(ty);
+  auto Add = make_unique<BinaryOp>(BinaryOp::add, *T->slots[0], *RC, ty);
+  auto Sub = make_unique<BinaryOp>(BinaryOp::sub, *T->slots[0],
+                                   *T->slots[1], ty);
+  T->sketches.push_back({Add.get(), {RC.get()}});
+  T->sketches.push_back({Sub.get(), {}});
+  T->exprs.emplace_back(std::move(RC));
+  T->exprs.emplace_back(std::move(Add));
+  T->exprs.emplace_back(std::move(Sub));
+  return T;
+}
+
+TEST(SketchTest, InstantiateBindsSlots) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(Source, Err, C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("f");
+  Var X(F.getArg(0)), Y(F.getArg(1));
+
+  auto T = makeTemplate();
+  string Before = str(T->sketches[0].first) + str(T->sketches[1].first);
+
+  vector<unique_ptr<Inst>> exprs;
+  vector<Sketch> First, Second;
+  instantiate(*T, {&Y, &X}, First, exprs);
+  instantiate(*T, {&Y, &X}, Second, exprs);
+  ASSERT_EQ(First.size(), 2u);
+  ASSERT_EQ(Second.size(), 2u);
+
+  type ty = type::IntegerVectorizable(4, 32);
+  ReservedConst RC(ty);
+  BinaryOp Add(BinaryOp::add, Y, RC, ty);
+  BinaryOp Sub(BinaryOp::sub, Y, X, ty);
+  EXPECT_EQ(str(First[0].first), str(&Add));
+  EXPECT_EQ(str(First[1].first), str(&Sub));
+
+  // every instantiation gets its own constants, the template is untouched
+  auto *B = dynamic_cast<BinaryOp*>(First[0].first);
+  ASSERT_TRUE(B != nullptr);
+  ASSERT_EQ(First[0].second.size(), 1u);
+  EXPECT_EQ(*First[0].second.begin(), B->R());
+  EXPECT_NE(*First[0].second.begin(), *Second[0].second.begin());
+  EXPECT_NE(*First[0].second.begin(), *T->sketches[0].second.begin());
+  EXPECT_TRUE(First[1].second.empty());
+  EXPECT_EQ(str(T->sketches[0].first) + str(T->sketches[1].first), Before);
+}
+
+TEST(SketchTest, CacheKey) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(Source, Err, C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("f");
+  Var X(F.getArg(0)), Y(F.getArg(1)), W(F.getArg(2));
+  type ty = type::IntegerVectorizable(4, 32);
+
+  // only the types matter
+  EXPECT_EQ(SketchCache::key({&X, &W}, ty, "avx2", {}),
+            SketchCache::key({&Y, &W}, ty, "avx2", {}));
+  EXPECT_NE(SketchCache::key({&X, &W}, ty, "avx2", {}),
+            SketchCache::key({&W, &X}, ty, "avx2", {}));
+  EXPECT_NE(SketchCache::key({&X, &W}, ty, "avx2", {}),
+            SketchCache::key({&X, &W}, ty, "avx2,avx512f", {}));
+  llvm::FastMathFlags Fast;
+  Fast.setFast();
+  EXPECT_NE(SketchCache::key({&X, &W}, ty, "avx2", {}),
+            SketchCache::key({&X, &W}, ty, "avx2", Fast));
+  EXPECT_NE(SketchCache::key({&X, &W}, ty, "avx2", {}),
+            SketchCache::key({&X, &W}, type::IntegerVectorizable(8, 16),
+                             "avx2", {}));
+
+  auto &Cache = SketchCache::get();
+  string Key = SketchCache::key({&X, &Y}, ty, "avx2", {});
+  shared_ptr<const SketchTemplate> T = makeTemplate();
+  Cache.insert(Key, T);
+  EXPECT_EQ(Cache.lookup(Key), T);
+}
+
+TEST(SketchTest, Tiers) {
+  auto T = makeTemplate();
+  type ty = type::IntegerVectorizable(4, 32);
+  EXPECT_EQ(tierOf(T->sketches[0]), Tier::Holes);
+  EXPECT_EQ(tierOf(T->sketches[1]), Tier::SingleOp);
+  EXPECT_EQ(tierOf({T->slots[0], {}}), Tier::Trivial);
+
+  ReservedConst RC(ty);
+  Copy CopyC(RC);
+  EXPECT_EQ(tierOf({&CopyC, {&RC}}), Tier::Holes);
+
+  BinaryOp Sub(BinaryOp::sub, *T->slots[0], *T->slots[1], ty);
+  BinaryOp Nested(BinaryOp::mul, Sub, *T->slots[1], ty);
+  EXPECT_EQ(tierOf({&Nested, {}}), Tier::Complex);
+
+  // only the sketches of the tier asked for are instantiated
+  T->tiers = { Tier::Holes, Tier::SingleOp };
+  vector<unique_ptr<Inst>> exprs;
+  vector<Sketch> Sketches;
+  instantiate(*T, T->slots, Sketches, exprs, Tier::SingleOp);
+  ASSERT_EQ(Sketches.size(), 1u);
+  EXPECT_EQ(str(Sketches[0].first), str(T->sketches[1].first));
+}
+
+TEST(SketchTest, TargetFeatures) {
+  // implied features are enabled too
+  auto Haswell = TargetFeatures::get("haswell", "");
+  EXPECT_TRUE(Haswell.has("avx2"));
+  EXPECT_TRUE(Haswell.has("sse4.1"));
+  EXPECT_FALSE(Haswell.has("avx512f"));
+
+  auto BW = TargetFeatures::get("x86-64", "+avx512bw");
+  EXPECT_TRUE(BW.has("avx512f"));
+  EXPECT_TRUE(BW.has("avx2"));
+  EXPECT_FALSE(TargetFeatures::get("haswell", "-avx").has("avx2"));
+
+  // features no intrinsic depends on do not split the cache
+  EXPECT_EQ(Haswell.key(), TargetFeatures::get("haswell", "+popcnt").key());
+  EXPECT_NE(Haswell.key(), BW.key());
+}
+
+TEST(SketchTest, LaneHoles) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(R"(
+define <4 x i32> @f(<4 x i32> %x, <4 x i32> %y, <4 x i32> %z) {
+  %i = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 0, i32 4, i32 1, i32 5>
+  %r = shufflevector <4 x i32> %i, <4 x i32> poison, <4 x i32> <i32 2, i32 0, i32 poison, i32 1>
+  %e = extractelement <4 x i32> %y, i32 3
+  %s = insertelement <4 x i32> %z, i32 %e, i32 2
+  %a = add <4 x i32> %x, %y
+  ret <4 x i32> %r
+}
+)", Err, C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("f");
+  Var X(F.getArg(0)), Y(F.getArg(1)), Z(F.getArg(2));
+  auto inst = [&](const char *Name) {
+    for (auto &I : F.getEntryBlock())
+      if (I.getName() == Name)
+        return &I;
+    return (llvm::Instruction*)nullptr;
+  };
+  type ty = type::IntegerVectorizable(4, 32);
+
+  // the two shuffles fold to a single one of both inputs
+  ReservedConst Mask(ty);
+  FakeShuffleInst FS(X, &Y, Mask, ty);
+  unordered_map<ReservedConst*, llvm::Constant*> Holes;
+  ASSERT_TRUE(solveLaneHoles(F, inst("r"), &FS, Holes));
+  auto *I32 = llvm::Type::getInt32Ty(C);
+  EXPECT_EQ(Holes[&Mask], llvm::ConstantVector::get({
+    llvm::ConstantInt::get(I32, 1), llvm::ConstantInt::get(I32, 0),
+    llvm::PoisonValue::get(I32), llvm::ConstantInt::get(I32, 4)}));
+
+  type ety = type::Integer(32);
+  ReservedConst Idx(type::Integer(16));
+  ExtractElement EE(Y, Idx, ety);
+  Holes.clear();
+  ASSERT_TRUE(solveLaneHoles(F, inst("e"), &EE, Holes));
+  auto *I16 = llvm::Type::getInt16Ty(C);
+  EXPECT_EQ(Holes[&Idx], llvm::ConstantInt::get(I16, 3));
+
+  Var E(inst("e"));
+  InsertElement IE(Z, E, Idx, ty);
+  Holes.clear();
+  ASSERT_TRUE(solveLaneHoles(F, inst("s"), &IE, Holes));
+  EXPECT_EQ(Holes[&Idx], llvm::ConstantInt::get(I16, 2));
+
+  // lanes that are computed, not moved, cannot be traced
+  Holes.clear();
+  EXPECT_FALSE(solveLaneHoles(F, inst("a"), &FS, Holes));
+}
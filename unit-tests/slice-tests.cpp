@@ -0,0 +1,342 @@
+// Copyright (c) 2020-present, author: Zhengyang Liu (liuz@cs.utah.edu).
+// Distributed under the MIT license that can be found in the LICENSE file.
+
+#include "gtest/gtest.h"
+#include "config.h"
+#include "slice.h"
+#include "removal-slice.h"
+#include "utils.h"
+
+#include "llvm/Analysis/LoopInfo.h"
+#include "llvm/AsmParser/Parser.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/InstIterator.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Support/SourceMgr.h"
+
+#include <set>
+#include <string>
+
+using namespace std;
+using namespace minotaur;
+
+// a chain of n diamonds, %a is defined above the chain and used below it
+static string diamonds(unsigned n) {
+  string s = "define <4 x i32> @src(<4 x i32> %x, <4 x i32> %y, i1 %c) {\n"
+             "b0:\n"
+             "  %a = add <4 x i32> %x, %x\n"
+             "  br i1 %c, label %l1, label %r1\n";
+  for (unsigned i = 1; i <= n; ++i) {
+    string is = to_string(i);
+    s += "l" + is + ":\n  br label %b" + is + "\n";
+    s += "r" + is + ":\n  br label %b" + is + "\n";
+    s += "b" + is + ":\n";
+    if (i < n)
+      s += "  br i1 %c, label %l" + to_string(i + 1) + ", label %r" +
+           to_string(i + 1) + "\n";
+  }
+  s += "  %r = and <4 x i32> %a, %y\n"
+       "  ret <4 x i32> %r\n"
+       "}\n";
+  return s;
+}
+
+// the recursive enumeration of simple paths the slicer used to do
+static bool enumeratePaths(llvm::BasicBlock *current, llvm::BasicBlock *target,
+                           llvm::DominatorTree &DT,
+                           set<llvm::BasicBlock*> &visited,
+                           set<llvm::BasicBlock*> &result) {
+  if (visited.size() > 20)
+    return false;
+  if (current == target) {
+    result.insert(visited.begin(), visited.end());
+    return true;
+  }
+  for (llvm::BasicBlock *pred : llvm::predecessors(current)) {
+    if (visited.count(pred) || !DT.dominates(target, pred))
+      continue;
+    visited.insert(pred);
+    bool ok = enumeratePaths(pred, target, DT, visited, result);
+    visited.erase(pred);
+    if (!ok)
+      return false;
+  }
+  return true;
+}
+
+struct Diamonds {
+  llvm::LLVMContext C;
+  unique_ptr<llvm::Module> M;
+  llvm::Function *F;
+  unique_ptr<llvm::DominatorTree> DT;
+  unique_ptr<llvm::LoopInfo> LI;
+
+  Diamonds(unsigned n) {
+    llvm::SMDiagnostic Err;
+    M = llvm::parseAssemblyString(diamonds(n), Err, C);
+    F = M->getFunction("src");
+    DT = make_unique<llvm::DominatorTree>(*F);
+    LI = make_unique<llvm::LoopInfo>(*DT);
+  }
+
+  llvm::BasicBlock &block(const string &name) {
+    for (auto &BB : *F)
+      if (BB.getName() == name)
+        return BB;
+    llvm_unreachable("no such block");
+  }
+
+  llvm::Instruction &root() {
+    return *block("b" + to_string(F->size() / 3)).getFirstNonPHI();
+  }
+};
+
+TEST(SliceTest, PathMatchesEnumeration) {
+  MinotaurContext MC;
+  for (unsigned n : {1u, 3u, 9u}) {
+    Diamonds D(n);
+    ASSERT_TRUE(D.M != nullptr);
+    llvm::BasicBlock *from = &D.block("b" + to_string(n));
+    llvm::BasicBlock *to = &D.block("b0");
+
+    set<llvm::BasicBlock*> visited = { from }, expected;
+    ASSERT_TRUE(enumeratePaths(from, to, *D.DT, visited, expected));
+
+    SliceCache SC(*D.F, *D.LI, *D.DT, MC);
+    auto &path = SC.getPath(from, to);
+    ASSERT_TRUE(path.has_value());
+    EXPECT_EQ(*path, expected);
+    EXPECT_EQ(path->size(), 3 * n + 1);
+  }
+}
+
+TEST(SliceTest, DistantBlocksAreRejected) {
+  MinotaurContext MC;
+  Diamonds D(10);
+  ASSERT_TRUE(D.M != nullptr);
+  Slice S(*D.F, *D.LI, *D.DT, MC);
+  EXPECT_FALSE(S.extractExpr(D.root()).has_value());
+}
+
+TEST(SliceTest, DiamondChainCut) {
+  MinotaurContext MC;
+  Diamonds D(9);
+  ASSERT_TRUE(D.M != nullptr);
+  Slice S(*D.F, *D.LI, *D.DT, MC);
+  auto NewF = S.extractExpr(D.root());
+  ASSERT_TRUE(NewF.has_value());
+  // every block of the chain plus the sink
+  EXPECT_EQ(NewF->first.get().size(), 3 * 9 + 1 + 1);
+}
+
+// the reachability computed on the largest chain the slicer accepts is the
+// one the path enumeration finds, also when the cache answers it again
+TEST(SliceTest, DiamondChainRepeated) {
+  MinotaurContext MC;
+  Diamonds D(9);
+  ASSERT_TRUE(D.M != nullptr);
+  llvm::BasicBlock *from = &D.block("b9");
+  llvm::BasicBlock *to = &D.block("b0");
+
+  set<llvm::BasicBlock*> visited = { from }, expected;
+  ASSERT_TRUE(enumeratePaths(from, to, *D.DT, visited, expected));
+
+  SliceCache SC(*D.F, *D.LI, *D.DT, MC);
+  for (unsigned r = 0; r < 3; ++r) {
+    auto &path = SC.getPath(from, to);
+    ASSERT_TRUE(path.has_value());
+    EXPECT_EQ(*path, expected);
+  }
+}
+
+TEST(SliceTest, RemovalKeepsRegion) {
+  MinotaurContext MC;
+  Diamonds D(3);
+  ASSERT_TRUE(D.M != nullptr);
+  RemovalSlice S(*D.F, *D.LI, *D.DT, MC);
+  auto NewF = S.extractExpr(D.root());
+  ASSERT_TRUE(NewF.has_value());
+  // the diamonds are kept as they are, no branch leaves the region
+  EXPECT_EQ(NewF->first.get().size(), 3 * 3 + 1);
+  // %a, %y and the branch condition
+  EXPECT_EQ(NewF->first.get().arg_size(), 3u);
+}
+
+static const char *Loop = R"(
+define <4 x i32> @loop(<4 x i32> %x, i32 %n) {
+entry:
+  br label %header
+header:
+  %acc = phi <4 x i32> [ %x, %entry ], [ %next, %latch ]
+  %i = phi i32 [ 0, %entry ], [ %i1, %latch ]
+  %t = add <4 x i32> %acc, %x
+  %c = icmp slt i32 %i, %n
+  br i1 %c, label %then, label %latch
+then:
+  %u = mul <4 x i32> %t, %t
+  br label %latch
+latch:
+  %m = phi <4 x i32> [ %u, %then ], [ %t, %header ]
+  %next = xor <4 x i32> %m, %x
+  %i1 = add i32 %i, 1
+  %e = icmp eq i32 %i1, %n
+  br i1 %e, label %exit, label %header
+exit:
+  ret <4 x i32> %next
+}
+)";
+
+TEST(SliceTest, RemovalCutsLoops) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(Loop, Err, C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("loop");
+  llvm::DominatorTree DT(F);
+  llvm::LoopInfo LI(DT);
+  auto *Root = cast<llvm::Instruction>(
+    F.getValueSymbolTable()->lookup("next"));
+
+  MinotaurContext MC;
+  RemovalSlice S(F, LI, DT, MC);
+  auto NewF = S.extractExpr(*Root);
+  ASSERT_TRUE(NewF.has_value());
+
+  // header, then and latch; the loop-carried %acc and the condition of the
+  // header become arguments
+  llvm::Function &Cut = NewF->first.get();
+  EXPECT_EQ(Cut.size(), 3u);
+  ASSERT_EQ(Cut.arg_size(), 3u);
+  auto &VMap = S.getValueMap();
+  EXPECT_EQ(VMap[Cut.getArg(0)], F.getValueSymbolTable()->lookup("acc"));
+  EXPECT_EQ(VMap[Cut.getArg(1)], F.getArg(0));
+  EXPECT_EQ(VMap[Cut.getArg(2)], F.getValueSymbolTable()->lookup("c"));
+  EXPECT_EQ(VMap[NewF->second], Root);
+}
+
+static const char *Truncated = R"(
+define i8 @truncated(i32 %x, i32 %y) {
+  %a = add i32 %x, %y
+  %t = trunc i32 %a to i8
+  ret i8 %t
+}
+)";
+
+TEST(SliceTest, DemandedBitsMask) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(Truncated, Err, C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("truncated");
+  llvm::DominatorTree DT(F);
+  llvm::LoopInfo LI(DT);
+  auto *Root = cast<llvm::Instruction>(F.getValueSymbolTable()->lookup("a"));
+
+  MinotaurContext MC;
+  Slice S(F, LI, DT, MC);
+  auto NewF = S.extractExpr(*Root);
+  ASSERT_TRUE(NewF.has_value());
+
+  // only the low byte of %a is used, the cut returns it masked
+  auto *Ret = cast<llvm::ReturnInst>(NewF->second->getParent()->getTerminator());
+  auto *Mask = dyn_cast<llvm::BinaryOperator>(Ret->getReturnValue());
+  ASSERT_TRUE(Mask != nullptr);
+  EXPECT_EQ(Mask->getOpcode(), llvm::Instruction::And);
+  EXPECT_EQ(Mask->getOperand(0), NewF->second);
+  auto *Bits = dyn_cast<llvm::ConstantInt>(Mask->getOperand(1));
+  ASSERT_TRUE(Bits != nullptr);
+  EXPECT_EQ(Bits->getZExtValue(), 0xffu);
+}
+
+static const char *Unpack = R"(
+define <4 x i32> @unpack(<4 x i32> %x, <4 x i32> %y) {
+  %lo = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 0, i32 4, i32 1, i32 5>
+  %hi = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 2, i32 6, i32 3, i32 7>
+  %r = add <4 x i32> %lo, %hi
+  ret <4 x i32> %r
+}
+)";
+
+TEST(SliceTest, MultiRootCut) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(Unpack, Err, C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("unpack");
+  llvm::DominatorTree DT(F);
+  llvm::LoopInfo LI(DT);
+  auto *Lo = cast<llvm::Instruction>(F.getValueSymbolTable()->lookup("lo"));
+  auto *Hi = cast<llvm::Instruction>(F.getValueSymbolTable()->lookup("hi"));
+
+  // both shuffles read %x and %y, the add reads neither
+  auto Groups = relatedRoots(F.getEntryBlock());
+  ASSERT_EQ(Groups.size(), 1u);
+  EXPECT_EQ(Groups[0], (vector<llvm::Instruction*>{ Lo, Hi }));
+
+  MinotaurContext MC;
+  Slice S(F, LI, DT, MC);
+  auto NewF = S.extractExprs(Groups[0]);
+  ASSERT_TRUE(NewF.has_value());
+
+  // the cut returns the roots side by side
+  llvm::Function &Cut = NewF->first.get();
+  EXPECT_EQ(Cut.getReturnType(),
+            llvm::FixedVectorType::get(llvm::Type::getInt32Ty(C), 8));
+  auto Roots = cut_roots(NewF->second);
+  ASSERT_EQ(Roots.size(), 2u);
+  auto &VMap = S.getValueMap();
+  EXPECT_EQ(VMap[Roots[0]], Lo);
+  EXPECT_EQ(VMap[Roots[1]], Hi);
+  EXPECT_EQ(cut_roots(Lo).size(), 1u);
+
+  // roots of different types are not cut together, the compare is detached
+  // so that the function under test is left as it is
+  Slice S2(F, LI, DT, MC);
+  unique_ptr<llvm::ICmpInst> Cmp(
+    new llvm::ICmpInst(llvm::CmpInst::ICMP_EQ, Lo, Hi));
+  EXPECT_FALSE(S2.extractExprs({ Lo, Cmp.get() }).has_value());
+}
+
+static const char *UnpackMasked = R"(
+define <4 x i16> @unpack(<4 x i32> %x, <4 x i32> %y) {
+  %lo = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 0, i32 4, i32 1, i32 5>
+  %hi = shufflevector <4 x i32> %x, <4 x i32> %y, <4 x i32> <i32 2, i32 6, i32 3, i32 7>
+  %t = trunc <4 x i32> %lo to <4 x i16>
+  %u = trunc <4 x i32> %hi to <4 x i16>
+  %r = add <4 x i16> %t, %u
+  ret <4 x i16> %r
+}
+)";
+
+// the roots are masked to their demanded bits, cut_roots still gives the
+// clones of the roots and not the masks
+TEST(SliceTest, MultiRootCutMasked) {
+  llvm::LLVMContext C;
+  llvm::SMDiagnostic Err;
+  auto M = llvm::parseAssemblyString(UnpackMasked, Err, C);
+  ASSERT_TRUE(M != nullptr);
+  llvm::Function &F = *M->getFunction("unpack");
+  llvm::DominatorTree DT(F);
+  llvm::LoopInfo LI(DT);
+  auto *Lo = cast<llvm::Instruction>(F.getValueSymbolTable()->lookup("lo"));
+  auto *Hi = cast<llvm::Instruction>(F.getValueSymbolTable()->lookup("hi"));
+
+  MinotaurContext MC;
+  Slice S(F, LI, DT, MC);
+  auto NewF = S.extractExprs({ Lo, Hi });
+  ASSERT_TRUE(NewF.has_value());
+
+  unsigned Masks = 0;
+  for (auto &I : llvm::instructions(NewF->first.get()))
+    Masks += I.getName().starts_with(DEMANDED);
+  EXPECT_EQ(Masks, 2u);
+
+  auto Roots = cut_roots(NewF->second);
+  ASSERT_EQ(Roots.size(), 2u);
+  auto &VMap = S.getValueMap();
+  EXPECT_EQ(VMap[Roots[0]], Lo);
+  EXPECT_EQ(VMap[Roots[1]], Hi);
+}